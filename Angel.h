@@ -16,6 +16,7 @@
 
 #include <cmath>
 #include <iostream>
+#include <vector>
 
 //  Define M_PI in the case it's not defined in the math header file
 #ifndef M_PI
@@ -50,22 +51,125 @@
 
 namespace Angel {
 
-//  Helper function to load vertex and fragment shader files
-GLuint InitShader( const char* vertexShaderFile,
-		   const char* fragmentShaderFile );
+//  Helper function to read a shader file into a NULL-terminated string,
+//    which the caller releases with delete[]
+char* readShaderSource( const char* shaderFile );
+
+//  The source of a shader, found without copying it.  A file of the same
+//    name in the directory named by the SHADER_DIR environment variable is
+//    mapped into memory; otherwise the copy built into the program is used,
+//    and failing that the file itself is mapped.  The text isn't always
+//    NULL-terminated, so use size().
+class ShaderSource {
+    const char*  text;
+    size_t       length;
+    void*        mapping;	// of a file, unmapped on destruction
+
+    bool map( const char* path );
+
+    ShaderSource( const ShaderSource& );
+    ShaderSource& operator = ( const ShaderSource& );
+
+   public:
+    explicit ShaderSource( const char* shaderFile );
+    ~ShaderSource();
+
+    bool isValid() const { return text != NULL; }
+    const char* data() const { return text; }
+    size_t size() const { return length; }
+};
 
 //  Defined constant for when numbers are too small to be used in the
 //    denominator of a division operation.  This is only used if the
 //    DEBUG macro is defined.
-const GLfloat  DivideByZeroTolerance = GLfloat(1.0e-07);
+constexpr GLfloat  DivideByZeroTolerance = GLfloat(1.0e-07);
 
 //  Degrees-to-radians constant 
-const GLfloat  DegreesToRadians = M_PI / 180.0;
+constexpr GLfloat  DegreesToRadians = M_PI / 180.0;
 
 }  // namespace Angel
 
 #include "vec.h"
 #include "mat.h"
+#include "program.h"
+
+namespace Angel {
+
+//  Helper function to load vertex and fragment shader files, returning the
+//    linked program with its uniforms and attributes already looked up.
+//    Linked programs are cached on disk, so a later launch with the same
+//    sources and driver skips compiling them.  The cache is in the
+//    directory named by SHADER_CACHE_DIR, or else in angel-shaders under
+//    $XDG_CACHE_HOME or ~/.cache.
+Program InitShader( const char* vertexShaderFile,
+		    const char* fragmentShaderFile );
+
+//  Programs compiled and linked together.  add() only starts the work, so
+//    the driver can compile every program at once, on its own threads with
+//    KHR_parallel_shader_compile, while the caller gets on with other
+//    setup; finish() waits for them all and checks them, exiting on errors
+//    as InitShader() does.
+class ProgramBatch {
+    struct pending;
+    std::vector<pending*> programs;
+
+   public:
+    ~ProgramBatch();
+
+    //  Starts building the program of the two shader files, which finish()
+    //    stores in program.  In both files, #include "file" lines are
+    //    replaced by that file, and each NAME or NAME=VALUE of defines,
+    //    separated by spaces, is #defined after the #version line, or
+    //    first in a file without one.  Compile errors give lines as they
+    //    are in their files, which are numbered in the order they are
+    //    read.  A variant built before, by any batch, is reused.
+    void add( Program& program, const char* vertexShaderFile,
+	      const char* fragmentShaderFile, const char* defines = "" );
+
+    //  Whether every program is built, so finish() won't wait.  Without
+    //    KHR_parallel_shader_compile that can't be told, and it's true.
+    bool isReady() const;
+
+    void finish();
+};
+
+//  Rebuilds programs while the game runs, when a shader file they are
+//    built from changes in the directory named by SHADER_DIR, which inotify
+//    watches.  Only the programs depending on the file are rebuilt, in the
+//    background, and update() swaps them in together once they are all
+//    built.  Each keeps the uniform values, uniform block bindings and
+//    attribute locations of the program it replaces, so vertex arrays stay
+//    valid.  A program that fails to build is reported and the old one is
+//    kept.  Every Program holding a rebuilt variant must be watched, as
+//    the old program is deleted.
+class ShaderWatcher {
+    struct rebuild;
+    int                    fd;
+    std::vector<Program*>  targets;
+    std::vector<rebuild*>  rebuilds;
+
+    ShaderWatcher( const ShaderWatcher& );
+    ShaderWatcher& operator = ( const ShaderWatcher& );
+
+   public:
+    ShaderWatcher();
+    ~ShaderWatcher();
+
+    //  Starts watching SHADER_DIR, returning false if it isn't set or
+    //    can't be watched
+    bool start();
+
+    //  Keeps program up to date with its shader files
+    void watch( Program& program ) { targets.push_back( &program ); }
+
+    //  Starts rebuilding the programs whose files changed, and swaps in
+    //    the rebuilt ones if they are all done; call between frames.
+    //    Returns whether any program was replaced, after which uniform
+    //    handles must be looked up again and no program is in use.
+    bool update();
+};
+
+}  // namespace Angel
 //#include "CheckError.h"
 
 // #define Print(x)  do { std::cerr << #x " = " << (x) << std::endl; } while(0)
@@ -1,9 +1,27 @@
 #include "Angel.h"
+#include <vector>
+#include <deque>
+#include <string>
+#include <cstring>
+#include <sstream>
+#include <algorithm>
+#include <map>
+#include <stdint.h>
+#include <cstdlib>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif  // __linux__
+#include "shaders_embedded.h"
 
 namespace Angel {
 
 	// Create a NULL-terminated string by reading the provided file
-	static char*
+	char*
 	readShaderSource(const char* shaderFile)
 	{
 		FILE* fp = fopen(shaderFile, "r");
@@ -26,69 +44,1003 @@ namespace Angel {
 	}
 
 
-	// Create a GLSL program object from vertex and fragment shader files
-	GLuint
-	InitShader(const char* vShaderFile, const char* fShaderFile)
+	ShaderSource::ShaderSource(const char* shaderFile)
+		: text(NULL), length(0), mapping(NULL)
 	{
-		struct Shader {
-			const char*  filename;
-			GLenum       type;
-			GLchar*      source;
-		}  shaders[2] = {
-			{ vShaderFile, GL_VERTEX_SHADER, NULL },
-			{ fShaderFile, GL_FRAGMENT_SHADER, NULL }
-		};
-
-		GLuint program = glCreateProgram();
-		
-		for ( int i = 0; i < 2; ++i ) {
-			Shader& s = shaders[i];
-			s.source = readShaderSource( s.filename );
-			if ( shaders[i].source == NULL ) {
-				std::cerr << "Failed to read " << s.filename << std::endl;
-				exit( EXIT_FAILURE );
+		const char* overrideDirectory = getenv("SHADER_DIR");
+		if ( overrideDirectory != NULL &&
+		     map( (std::string(overrideDirectory) + "/" + shaderFile).c_str() ) ) {
+			return;
+		}
+
+		for ( size_t i = 0; i < NumEmbeddedShaders; ++i ) {
+			if ( strcmp( EmbeddedShaders[i].name, shaderFile ) == 0 ) {
+				text = EmbeddedShaders[i].source;
+				length = EmbeddedShaders[i].size;
+				return;
 			}
+		}
 
-			GLuint shader = glCreateShader( s.type );
-			glShaderSource( shader, 1, (const GLchar**) &s.source, NULL );
-			glCompileShader( shader );
+		map( shaderFile );
+	}
 
-			GLint  compiled;
-			glGetShaderiv( shader, GL_COMPILE_STATUS, &compiled );
-			if ( !compiled ) {
-				std::cerr << s.filename << " failed to compile:" << std::endl;
-				GLint  logSize;
-				glGetShaderiv( shader, GL_INFO_LOG_LENGTH, &logSize );
-				char* logMsg = new char[logSize];
-				glGetShaderInfoLog( shader, logSize, NULL, logMsg );
-				std::cerr << logMsg << std::endl;
-				delete [] logMsg;
 
-				exit( EXIT_FAILURE );
+	ShaderSource::~ShaderSource()
+	{
+		if ( mapping != NULL ) {
+			munmap( mapping, length );
+		}
+	}
+
+
+	// Map the file at path, returning whether it could be
+	bool
+	ShaderSource::map(const char* path)
+	{
+		int fd = open(path, O_RDONLY);
+		if ( fd < 0 ) {
+			return false;
+		}
+
+		struct stat info;
+		void* p = MAP_FAILED;
+		if ( fstat(fd, &info) == 0 && info.st_size > 0 ) {
+			p = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		}
+		close(fd);
+		if ( p == MAP_FAILED ) {
+			return false;
+		}
+
+		mapping = p;
+		text = (const char*) p;
+		length = info.st_size;
+		return true;
+	}
+
+
+	// Read the active uniforms and attributes of a linked program
+	Program::Program(GLuint id) : id(id)
+	{
+		GLint count, maxLength;
+		GLint size;
+		GLenum type;
+
+		glGetProgramiv( id, GL_ACTIVE_UNIFORMS, &count );
+		glGetProgramiv( id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength );
+		std::vector<GLchar> name( maxLength + 1 );
+		for ( GLint i = 0; i < count; ++i ) {
+			glGetActiveUniform( id, i, name.size(), NULL, &size, &type, &name[0] );
+
+			// Members of uniform blocks have no location
+			GLint location = glGetUniformLocation( id, &name[0] );
+			if ( location < 0 ) {
+				continue;
+			}
+
+			// Arrays are reported as their first element
+			std::string key( &name[0] );
+			if ( key.size() > 3 && key.compare( key.size() - 3, 3, "[0]" ) == 0 ) {
+				key.resize( key.size() - 3 );
+			}
+			variable v = { location, type };
+			uniforms[key] = v;
+		}
+
+		glGetProgramiv( id, GL_ACTIVE_ATTRIBUTES, &count );
+		glGetProgramiv( id, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &maxLength );
+		name.resize( maxLength + 1 );
+		for ( GLint i = 0; i < count; ++i ) {
+			glGetActiveAttrib( id, i, name.size(), NULL, &size, &type, &name[0] );
+
+			variable v = { glGetAttribLocation( id, &name[0] ), type };
+			attribs[&name[0]] = v;
+		}
+	}
+
+
+	// Directory linked programs are cached in: SHADER_CACHE_DIR if it is
+	//   set, and otherwise ShaderCacheName in the user's cache directory,
+	//   $XDG_CACHE_HOME or ~/.cache.  Empty if there is none, which turns
+	//   the cache off.
+	const char* const ShaderCacheName = "angel-shaders";
+
+	static std::string
+	shaderCacheDirectory()
+	{
+		const char* directory = getenv("SHADER_CACHE_DIR");
+		if ( directory != NULL && *directory != '\0' ) {
+			return directory;
+		}
+		// Relative XDG paths are to be ignored
+		const char* cacheHome = getenv("XDG_CACHE_HOME");
+		if ( cacheHome != NULL && *cacheHome == '/' ) {
+			return std::string( cacheHome ) + "/" + ShaderCacheName;
+		}
+		const char* home = getenv("HOME");
+		if ( home != NULL && *home != '\0' ) {
+			return std::string( home ) + "/.cache/" + ShaderCacheName;
+		}
+		return "";
+	}
+
+	// Creates directory and any of its parents that are missing,
+	//   returning whether it exists afterwards
+	static bool
+	makeDirectories(const std::string& directory)
+	{
+		for ( size_t slash = directory.find( '/', 1 ); ;
+		      slash = directory.find( '/', slash + 1 ) ) {
+			std::string parent = directory.substr( 0, slash );
+			if ( mkdir( parent.c_str(), 0755 ) != 0 && errno != EEXIST ) {
+				return false;
+			}
+			if ( slash == std::string::npos ) {
+				return true;
+			}
+		}
+	}
+
+	// 64-bit FNV-1a hash of size bytes of data, continuing from hash
+	static uint64_t
+	fnv1a(uint64_t hash, const char* data, size_t size)
+	{
+		for ( size_t i = 0; i < size; ++i ) {
+			hash ^= (unsigned char) data[i];
+			hash *= 1099511628211ULL;
+		}
+		return hash;
+	}
+
+	// A shader's source with its includes expanded and its defines
+	//   injected, as the pieces of the files it comes from.  They are
+	//   handed to glShaderSource() as they are, rather than copied together.
+	//   #line directives keep each line numbered as it is in its file, the
+	//   file being given by its position in included, so compile errors
+	//   point at the file and line to fix.
+	struct ExpandedSource {
+		std::vector<ShaderSource*>  files;	// mapped until compiled
+		std::vector<std::string>    included;
+		std::string                 defines;
+		std::deque<std::string>     directives;	// #line pieces, which never move
+		int                         version;	// of GLSL, from the main file
+		std::vector<const GLchar*>  pieces;
+		std::vector<GLint>          lengths;
+
+		ExpandedSource(const char* shaderFile, const char* defineList);
+		~ExpandedSource();
+
+		bool isValid() const { return !pieces.empty(); }
+
+	   private:
+		void addPiece(const char* begin, const char* end);
+		void addLineDirective(int line, size_t fileNumber);
+		bool expand(const char* shaderFile, bool isMain);
+	};
+
+	// Whether the line from begin to end is the preprocessor directive
+	static bool
+	isDirective(const char* begin, const char* end, const char* directive)
+	{
+		while ( begin < end && (*begin == ' ' || *begin == '\t') ) {
+			++begin;
+		}
+		size_t length = strlen(directive);
+		return size_t(end - begin) >= length && strncmp(begin, directive, length) == 0;
+	}
+
+	// Expand shaderFile, turning each NAME or NAME=VALUE of defineList,
+	//   separated by spaces, into a #define after its #version line, or at
+	//   its start if it has none
+	ExpandedSource::ExpandedSource(const char* shaderFile, const char* defineList)
+		: version(0)
+	{
+		std::istringstream words( defineList );
+		std::string word;
+		while ( words >> word ) {
+			size_t equals = word.find( '=' );
+			if ( equals == std::string::npos ) {
+				defines += "#define " + word + " 1\n";
+			}
+			else {
+				defines += "#define " + word.substr( 0, equals ) + " " +
+					word.substr( equals + 1 ) + "\n";
+			}
+		}
+
+		if ( !expand( shaderFile, true ) ) {
+			pieces.clear();
+			lengths.clear();
+		}
+	}
+
+	ExpandedSource::~ExpandedSource()
+	{
+		for ( size_t i = 0; i < files.size(); ++i ) {
+			delete files[i];
+		}
+	}
+
+	void
+	ExpandedSource::addPiece(const char* begin, const char* end)
+	{
+		if ( begin < end ) {
+			pieces.push_back( begin );
+			lengths.push_back( end - begin );
+		}
+	}
+
+	// Add a directive numbering the next line line of file fileNumber.
+	//   Before GLSL 3.30, #line gave the number of the line it is on.
+	void
+	ExpandedSource::addLineDirective(int line, size_t fileNumber)
+	{
+		std::ostringstream directive;
+		directive << "#line " << (version < 330 ? line - 1 : line) << " " << fileNumber << "\n";
+		directives.push_back( directive.str() );
+		const std::string& added = directives.back();
+		addPiece( added.data(), added.data() + added.size() );
+	}
+
+	// The version given by the #version line from text to end, or 0 if
+	//   there isn't one
+	static int
+	versionOf(const char* text, const char* end)
+	{
+		while ( text < end ) {
+			const char* lineEnd = std::find( text, end, '\n' );
+			if ( isDirective( text, lineEnd, "#version" ) ) {
+				std::istringstream line( std::string( text, lineEnd ) );
+				std::string directive;
+				int version = 0;
+				line >> directive >> version;
+				return version;
+			}
+			text = lineEnd < end ? lineEnd + 1 : end;
+		}
+		return 0;
+	}
+
+	// Add the pieces of shaderFile, replacing each #include "file" line with
+	//   that file the first time it is included and dropping it after.
+	//   Each file is numbered from its first line, and again after each
+	//   include and the main file's defines.
+	bool
+	ExpandedSource::expand(const char* shaderFile, bool isMain)
+	{
+		size_t fileNumber = included.size();
+		ShaderSource* source = new ShaderSource( shaderFile );
+		files.push_back( source );
+		included.push_back( shaderFile );
+		if ( !source->isValid() ) {
+			std::cerr << "Failed to read " << shaderFile << std::endl;
+			return false;
+		}
+
+		const char* text = source->data();
+		const char* end = text + source->size();
+		const char* piece = text;
+		if ( !isMain ) {
+			addLineDirective( 1, fileNumber );
+		}
+		else if ( (version = versionOf( text, end )) == 0 ) {
+			// Without a #version line, which must come first, the defines
+			//   can, and the shader is GLSL 1.10
+			version = 110;
+			addPiece( defines.data(), defines.data() + defines.size() );
+			addLineDirective( 1, fileNumber );
+		}
+
+		int line = 1;
+		while ( text < end ) {
+			const char* lineEnd = std::find( text, end, '\n' );
+			const char* next = lineEnd < end ? lineEnd + 1 : end;
+
+			if ( isDirective( text, lineEnd, "#include" ) ) {
+				addPiece( piece, text );
+				piece = next;
+
+				const char* open = std::find( text, lineEnd, '"' );
+				const char* close = open < lineEnd ? std::find( open + 1, lineEnd, '"' ) : lineEnd;
+				if ( close == lineEnd ) {
+					std::cerr << shaderFile << ": #include needs a \"file\"" << std::endl;
+					return false;
+				}
+				std::string name( open + 1, close );
+				if ( std::find( included.begin(), included.end(), name ) == included.end() ) {
+					if ( !expand( name.c_str(), false ) ) {
+						return false;
+					}
+					// In case the file doesn't end its last line
+					addPiece( "\n", "\n" + 1 );
+				}
+				addLineDirective( line + 1, fileNumber );
 			}
+			else if ( isMain && isDirective( text, lineEnd, "#version" ) ) {
+				addPiece( piece, next );
+				addPiece( defines.data(), defines.data() + defines.size() );
+				addLineDirective( line + 1, fileNumber );
+				piece = next;
+			}
+			text = next;
+			++line;
+		}
+		addPiece( piece, end );
+		return true;
+	}
+
+	// Path of the cached binary of the program linked from sources by the
+	//   current driver, which a different source or driver never shares,
+	//   or empty if there is no cache directory
+	static std::string
+	programCachePath(const ExpandedSource* const sources[2])
+	{
+		static const std::string directory = shaderCacheDirectory();
+		if ( directory.empty() ) {
+			return directory;
+		}
+
+		uint64_t hash = 14695981039346656037ULL;
+		for ( int i = 0; i < 2; ++i ) {
+			for ( size_t j = 0; j < sources[i]->pieces.size(); ++j ) {
+				hash = fnv1a( hash, sources[i]->pieces[j], sources[i]->lengths[j] );
+			}
+			hash = fnv1a( hash, "", 1 );
+		}
+		const GLenum driver[] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+		for ( int i = 0; i < 3; ++i ) {
+			const char* name = (const char*) glGetString( driver[i] );
+			hash = fnv1a( hash, name, strlen(name) + 1 );
+		}
 
-			delete [] s.source;
+		char file[32];
+		snprintf( file, sizeof(file), "/%016llx.bin", (unsigned long long) hash );
+		return directory + file;
+	}
 
-			glAttachShader( program, shader );
+	// Loads the cached binary at path into program, returning whether it
+	//   was there and the driver accepted it
+	static bool
+	loadProgramBinary(GLuint program, const std::string& path)
+	{
+		FILE* fp = fopen(path.c_str(), "rb");
+		if ( fp == NULL ) {
+			return false;
 		}
 
-		/* link  and error check */
-		glLinkProgram(program);
+		GLenum format;
+		std::vector<char> binary;
+		bool isRead = fread(&format, sizeof(format), 1, fp) == 1;
+		if ( isRead ) {
+			long start = ftell(fp);
+			fseek(fp, 0L, SEEK_END);
+			binary.resize( ftell(fp) - start );
+			fseek(fp, start, SEEK_SET);
+			isRead = !binary.empty() &&
+				fread(&binary[0], 1, binary.size(), fp) == binary.size();
+		}
+		fclose(fp);
+		if ( !isRead ) {
+			return false;
+		}
+
+		glProgramBinary( program, format, &binary[0], binary.size() );
 
 		GLint  linked;
 		glGetProgramiv( program, GL_LINK_STATUS, &linked );
+		return linked;
+	}
+
+	// Writes the binary of the linked program to path, if the driver gives
+	//   one out.  It is written to a file of its own and renamed into
+	//   place, so that no one, another instance included, reads it half
+	//   written.  A binary that can't be saved is reported, and the
+	//   program just isn't cached.
+	static void
+	saveProgramBinary(GLuint program, const std::string& path)
+	{
+		GLint  size;
+		glGetProgramiv( program, GL_PROGRAM_BINARY_LENGTH, &size );
+		if ( size <= 0 ) {
+			return;
+		}
+
+		GLenum format;
+		std::vector<char> binary( size );
+		glGetProgramBinary( program, size, NULL, &format, &binary[0] );
+
+		std::string directory = path.substr( 0, path.rfind( '/' ) );
+		if ( !makeDirectories( directory ) ) {
+			std::cerr << "Can't create shader cache " << directory << ": "
+				  << strerror( errno ) << std::endl;
+			return;
+		}
+
+		char suffix[32];
+		snprintf( suffix, sizeof(suffix), ".%ld.tmp", (long) getpid() );
+		std::string temporary = path + suffix;
+		FILE* fp = fopen(temporary.c_str(), "wb");
+		if ( fp == NULL ) {
+			std::cerr << "Can't write " << temporary << ": " << strerror( errno )
+				  << std::endl;
+			return;
+		}
+		bool isWritten = fwrite(&format, sizeof(format), 1, fp) == 1 &&
+			fwrite(&binary[0], 1, binary.size(), fp) == binary.size();
+		isWritten = fclose(fp) == 0 && isWritten;
+		if ( !isWritten || rename( temporary.c_str(), path.c_str() ) != 0 ) {
+			std::cerr << "Can't write " << path << ": " << strerror( errno ) << std::endl;
+			unlink( temporary.c_str() );
+		}
+	}
+
+
+	// A program being built, from when its compiles are issued until it is
+	//   checked
+	struct programBuild {
+		const char*  filenames[2];
+		GLuint       program;
+		GLuint       shaders[2];
+		std::string  cachePath;
+		bool         isCached;
+		std::vector<std::string>  dependencies;	// every file it is built from
+		std::vector<std::string>  files[2];	// of each shader, by #line number
+
+		programBuild() : program(0), isCached(false)
+		{
+			filenames[0] = filenames[1] = NULL;
+			shaders[0] = shaders[1] = 0;
+		}
+	};
+
+	// A program of a batch, from when it is added until it is checked
+	struct ProgramBatch::pending {
+		Program*      target;
+		programBuild  build;
+		bool          isReused;	// shares an earlier variant's program
+	};
+
+	// Prints the info log of a shader or program
+	static void
+	printLog(GLuint object, bool isProgram)
+	{
+		GLint  logSize;
+		if ( isProgram ) {
+			glGetProgramiv( object, GL_INFO_LOG_LENGTH, &logSize );
+		}
+		else {
+			glGetShaderiv( object, GL_INFO_LOG_LENGTH, &logSize );
+		}
+		char* logMsg = new char[logSize + 1];
+		logMsg[0] = '\0';
+		if ( isProgram ) {
+			glGetProgramInfoLog( object, logSize + 1, NULL, logMsg );
+		}
+		else {
+			glGetShaderInfoLog( object, logSize + 1, NULL, logMsg );
+		}
+		std::cerr << logMsg << std::endl;
+		delete [] logMsg;
+	}
+
+	// Binds the attributes of program to the locations they have in
+	//   previous, before it is linked
+	static void
+	bindAttribLocations(GLuint program, GLuint previous)
+	{
+		GLint count, maxLength;
+		GLint size;
+		GLenum type;
+
+		glGetProgramiv( previous, GL_ACTIVE_ATTRIBUTES, &count );
+		glGetProgramiv( previous, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &maxLength );
+		std::vector<GLchar> name( maxLength + 1 );
+		for ( GLint i = 0; i < count; ++i ) {
+			glGetActiveAttrib( previous, i, name.size(), NULL, &size, &type, &name[0] );
+			GLint location = glGetAttribLocation( previous, &name[0] );
+			if ( location >= 0 ) {
+				glBindAttribLocation( program, location, &name[0] );
+			}
+		}
+	}
+
+	// Start building the program of the two shader files: load it from the
+	//   binary cache, or issue its compiles and link without asking how
+	//   they went, which would make the driver finish them first.  A
+	//   program rebuilt from previous keeps its attribute locations, so it
+	//   is always linked, as the cached binary may have others.  Returns
+	//   false if the sources can't be read.
+	static bool
+	startBuild(programBuild& build, const char* vShaderFile, const char* fShaderFile,
+		   const char* defines, GLuint previous)
+	{
+		const GLenum types[2] = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER };
+		ExpandedSource vSource( vShaderFile, defines ), fSource( fShaderFile, defines );
+		const ExpandedSource* sources[2] = { &vSource, &fSource };
+		for ( int i = 0; i < 2; ++i ) {
+			if ( !sources[i]->isValid() ) {
+				return false;
+			}
+		}
+
+		build.filenames[0] = vShaderFile;
+		build.filenames[1] = fShaderFile;
+		build.files[0] = vSource.included;
+		build.files[1] = fSource.included;
+		build.dependencies = vSource.included;
+		build.dependencies.insert( build.dependencies.end(), fSource.included.begin(),
+					   fSource.included.end() );
+		build.program = glCreateProgram();
+
+		bool isCacheable = GLEW_VERSION_4_1 || GLEW_ARB_get_program_binary;
+		if ( isCacheable ) {
+			build.cachePath = programCachePath( sources );
+			build.isCached = previous == 0 &&
+				loadProgramBinary( build.program, build.cachePath );
+			if ( !build.isCached ) {
+				// A rejected binary leaves the program unusable, so start over
+				glDeleteProgram( build.program );
+				build.program = glCreateProgram();
+				glProgramParameteri( build.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE );
+			}
+		}
+
+		if ( !build.isCached ) {
+			for ( int i = 0; i < 2; ++i ) {
+				build.shaders[i] = glCreateShader( types[i] );
+				glShaderSource( build.shaders[i], sources[i]->pieces.size(),
+					&sources[i]->pieces[0], &sources[i]->lengths[0] );
+				glCompileShader( build.shaders[i] );
+				glAttachShader( build.program, build.shaders[i] );
+			}
+			if ( previous != 0 ) {
+				bindAttribLocations( build.program, previous );
+			}
+			glLinkProgram( build.program );
+		}
+		return true;
+	}
+
+	// Whether the driver is done building, which without
+	//   KHR_parallel_shader_compile can't be told, so it's taken to be
+	static bool
+	isBuilt(const programBuild& build)
+	{
+		if ( !GLEW_KHR_parallel_shader_compile ) {
+			return true;
+		}
+		GLint  done;
+		glGetProgramiv( build.program, GL_COMPLETION_STATUS_KHR, &done );
+		return done;
+	}
+
+	// Check a build, reporting its errors, and release its shaders.
+	//   Returns whether the program linked.
+	static bool
+	checkBuild(programBuild& build)
+	{
+		GLint  linked;
+		glGetProgramiv( build.program, GL_LINK_STATUS, &linked );
 		if ( !linked ) {
-			std::cerr << "Shader program failed to link" << std::endl;
-			GLint  logSize;
-			glGetProgramiv( program, GL_INFO_LOG_LENGTH, &logSize);
-			char* logMsg = new char[logSize];
-			glGetProgramInfoLog( program, logSize, NULL, logMsg );
-			std::cerr << logMsg << std::endl;
-			delete [] logMsg;
+			// The link fails when a shader didn't compile, which is
+			//   the more useful error to report
+			bool isReported = false;
+			for ( int i = 0; i < 2 && !isReported; ++i ) {
+				GLint  compiled;
+				glGetShaderiv( build.shaders[i], GL_COMPILE_STATUS, &compiled );
+				if ( !compiled ) {
+					// Errors name the file by its number in the #lines
+					std::cerr << build.filenames[i] << " failed to compile, in files";
+					for ( size_t f = 0; f < build.files[i].size(); ++f ) {
+						std::cerr << " " << f << " " << build.files[i][f];
+					}
+					std::cerr << ":" << std::endl;
+					printLog( build.shaders[i], false );
+					isReported = true;
+				}
+			}
+			if ( !isReported ) {
+				std::cerr << "Shader program failed to link" << std::endl;
+				printLog( build.program, true );
+			}
+		}
+		else if ( !build.isCached && !build.cachePath.empty() ) {
+			saveProgramBinary( build.program, build.cachePath );
+		}
+
+		for ( int i = 0; i < 2; ++i ) {
+			if ( build.shaders[i] != 0 ) {
+				glDetachShader( build.program, build.shaders[i] );
+				glDeleteShader( build.shaders[i] );
+				build.shaders[i] = 0;
+			}
+		}
+		return linked;
+	}
 
+
+	// Deletes a build without checking it
+	static void
+	discardBuild(programBuild& build)
+	{
+		for ( int i = 0; i < 2; ++i ) {
+			if ( build.shaders[i] != 0 ) {
+				glDeleteShader( build.shaders[i] );
+			}
+		}
+		glDeleteProgram( build.program );
+	}
+
+	// A program built from two shader files and defines, and the files
+	//   it depends on
+	struct variant {
+		std::string  filenames[2];
+		std::string  defines;
+		GLuint       program;
+		std::vector<std::string>  dependencies;
+	};
+
+	// Every variant built so far, by its files and defines
+	static std::map<std::string, variant> variants;
+
+
+	// Builds a batch started and never finished are deleted, along with
+	//   their variants, which later batches can no longer reuse
+	ProgramBatch::~ProgramBatch()
+	{
+		for ( size_t i = 0; i < programs.size(); ++i ) {
+			pending* p = programs[i];
+			if ( !p->isReused ) {
+				std::map<std::string, variant>::iterator v = variants.begin();
+				while ( v != variants.end() ) {
+					if ( v->second.program == p->build.program ) {
+						variants.erase( v++ );
+					}
+					else {
+						++v;
+					}
+				}
+				discardBuild( p->build );
+			}
+			delete p;
+		}
+	}
+
+	// Start building a program, unless the same variant was built before
+	void
+	ProgramBatch::add(Program& target, const char* vShaderFile, const char* fShaderFile,
+			  const char* defines)
+	{
+		static bool isParallelSet = false;
+		if ( !isParallelSet && GLEW_KHR_parallel_shader_compile ) {
+			// As many compiler threads as the driver likes
+			glMaxShaderCompilerThreadsKHR( 0xFFFFFFFF );
+			isParallelSet = true;
+		}
+
+		pending* p = new pending;
+		p->target = &target;
+		p->isReused = false;
+		programs.push_back( p );
+
+		std::string key = std::string( vShaderFile ) + '\n' + fShaderFile + '\n' + defines;
+		std::map<std::string, variant>::iterator found = variants.find( key );
+		if ( found != variants.end() ) {
+			p->build.program = found->second.program;
+			p->build.isCached = true;
+			p->isReused = true;
+			return;
+		}
+
+		if ( !startBuild( p->build, vShaderFile, fShaderFile, defines, 0 ) ) {
 			exit( EXIT_FAILURE );
 		}
 
+		variant& v = variants[key];
+		v.filenames[0] = vShaderFile;
+		v.filenames[1] = fShaderFile;
+		v.defines = defines;
+		v.program = p->build.program;
+		v.dependencies = p->build.dependencies;
+	}
+
+
+	bool
+	ProgramBatch::isReady() const
+	{
+		for ( size_t i = 0; i < programs.size(); ++i ) {
+			if ( !isBuilt( programs[i]->build ) ) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+
+	// Check every program of the batch, in the order they were added, and
+	//   hand them out
+	void
+	ProgramBatch::finish()
+	{
+		for ( size_t i = 0; i < programs.size(); ++i ) {
+			pending* p = programs[i];
+			if ( !checkBuild( p->build ) ) {
+				exit( EXIT_FAILURE );
+			}
+			*p->target = Program( p->build.program );
+			delete p;
+		}
+		programs.clear();
+	}
+
+
+	// A variant being rebuilt, and the program it replaces
+	struct ShaderWatcher::rebuild {
+		std::string   key;
+		GLuint        previous;
+		programBuild  build;
+	};
+
+	// Copies to program what was set on previous: the values of its
+	//   uniforms, where program has them with the same type, and the
+	//   bindings of its uniform blocks.  Leaves program in use.
+	static void
+	copyProgramState(GLuint program, GLuint previous)
+	{
+		GLint count, maxLength;
+		GLint size;
+		GLenum type;
+
+		glGetProgramiv( program, GL_ACTIVE_UNIFORMS, &count );
+		glGetProgramiv( program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength );
+		std::vector<GLchar> name( maxLength + 1 );
+		std::map<std::string, GLenum> types;
+		for ( GLint i = 0; i < count; ++i ) {
+			glGetActiveUniform( program, i, name.size(), NULL, &size, &type, &name[0] );
+			types[&name[0]] = type;
+		}
+
+		glUseProgram( program );
+		glGetProgramiv( previous, GL_ACTIVE_UNIFORMS, &count );
+		glGetProgramiv( previous, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength );
+		name.resize( maxLength + 1 );
+		for ( GLint i = 0; i < count; ++i ) {
+			glGetActiveUniform( previous, i, name.size(), NULL, &size, &type, &name[0] );
+			std::map<std::string, GLenum>::const_iterator t = types.find( &name[0] );
+			if ( t == types.end() || t->second != type ) {
+				continue;
+			}
+
+			// Arrays are reported as their first element, and copied one
+			//   element at a time
+			std::string base( &name[0] );
+			bool isArray = base.size() > 3 && base.compare( base.size() - 3, 3, "[0]" ) == 0;
+			if ( isArray ) {
+				base.resize( base.size() - 3 );
+			}
+			for ( GLint j = 0; j < size; ++j ) {
+				std::ostringstream element;
+				element << base;
+				if ( isArray ) {
+					element << '[' << j << ']';
+				}
+
+				// Members of uniform blocks have no location
+				GLint from = glGetUniformLocation( previous, element.str().c_str() );
+				GLint to = glGetUniformLocation( program, element.str().c_str() );
+				if ( from < 0 || to < 0 ) {
+					continue;
+				}
+
+				GLfloat f[16];
+				GLint   n;
+				switch ( type ) {
+				case GL_FLOAT:
+					glGetUniformfv( previous, from, f );
+					glUniform1fv( to, 1, f );
+					break;
+				case GL_FLOAT_VEC2:
+					glGetUniformfv( previous, from, f );
+					glUniform2fv( to, 1, f );
+					break;
+				case GL_FLOAT_VEC3:
+					glGetUniformfv( previous, from, f );
+					glUniform3fv( to, 1, f );
+					break;
+				case GL_FLOAT_VEC4:
+					glGetUniformfv( previous, from, f );
+					glUniform4fv( to, 1, f );
+					break;
+				// Matrices are read back in GL's order, so not transposed
+				case GL_FLOAT_MAT3:
+					glGetUniformfv( previous, from, f );
+					glUniformMatrix3fv( to, 1, GL_FALSE, f );
+					break;
+				case GL_FLOAT_MAT4:
+					glGetUniformfv( previous, from, f );
+					glUniformMatrix4fv( to, 1, GL_FALSE, f );
+					break;
+				case GL_INT:
+				case GL_BOOL:
+				case GL_SAMPLER_2D:
+					glGetUniformiv( previous, from, &n );
+					glUniform1i( to, n );
+					break;
+				}
+			}
+		}
+
+		glGetProgramiv( previous, GL_ACTIVE_UNIFORM_BLOCKS, &count );
+		glGetProgramiv( previous, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &maxLength );
+		name.resize( maxLength + 1 );
+		for ( GLint i = 0; i < count; ++i ) {
+			GLint binding;
+			glGetActiveUniformBlockName( previous, i, name.size(), NULL, &name[0] );
+			glGetActiveUniformBlockiv( previous, i, GL_UNIFORM_BLOCK_BINDING, &binding );
+			GLuint index = glGetUniformBlockIndex( program, &name[0] );
+			if ( index != GL_INVALID_INDEX ) {
+				glUniformBlockBinding( program, index, binding );
+			}
+		}
+	}
+
+
+	ShaderWatcher::ShaderWatcher() : fd(-1)
+	{
+	}
+
+
+	ShaderWatcher::~ShaderWatcher()
+	{
+		for ( size_t i = 0; i < rebuilds.size(); ++i ) {
+			discardBuild( rebuilds[i]->build );
+			delete rebuilds[i];
+		}
+		if ( fd >= 0 ) {
+			close( fd );
+		}
+	}
+
+
+	// Watch for files in SHADER_DIR being written or moved there, as
+	//   editors that save to a temporary file and rename it do
+	bool
+	ShaderWatcher::start()
+	{
+		const char* directory = getenv("SHADER_DIR");
+		if ( directory == NULL ) {
+			return false;
+		}
+#ifdef __linux__
+		fd = inotify_init1( IN_NONBLOCK | IN_CLOEXEC );
+		if ( fd < 0 ) {
+			return false;
+		}
+		if ( inotify_add_watch( fd, directory, IN_CLOSE_WRITE | IN_MOVED_TO ) < 0 ) {
+			std::cerr << "Failed to watch " << directory << std::endl;
+			close( fd );
+			fd = -1;
+			return false;
+		}
+		return true;
+#else
+		return false;
+#endif  // __linux__
+	}
+
+
+	bool
+	ShaderWatcher::update()
+	{
+		if ( fd < 0 ) {
+			return false;
+		}
+
+		// Every file changed since the last update
+		std::vector<std::string> changed;
+#ifdef __linux__
+		char events[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+		ssize_t size;
+		while ( (size = read( fd, events, sizeof(events) )) > 0 ) {
+			for ( char* e = events; e < events + size; ) {
+				const struct inotify_event* event = (const struct inotify_event*) e;
+				if ( event->len > 0 ) {
+					changed.push_back( event->name );
+				}
+				e += sizeof(struct inotify_event) + event->len;
+			}
+		}
+#endif  // __linux__
+
+		// Start over on the watched variants depending on them, including
+		//   those already being rebuilt
+		for ( std::map<std::string, variant>::iterator v = variants.begin();
+		      v != variants.end() && !changed.empty(); ++v ) {
+			bool isWatched = false;
+			for ( size_t i = 0; i < targets.size(); ++i ) {
+				isWatched = isWatched || *targets[i] == v->second.program;
+			}
+			bool isChanged = false;
+			for ( size_t i = 0; i < changed.size(); ++i ) {
+				isChanged = isChanged || std::find( v->second.dependencies.begin(),
+					v->second.dependencies.end(), changed[i] ) != v->second.dependencies.end();
+			}
+			if ( !isWatched || !isChanged ) {
+				continue;
+			}
+
+			for ( size_t i = 0; i < rebuilds.size(); ++i ) {
+				if ( rebuilds[i]->key == v->first ) {
+					discardBuild( rebuilds[i]->build );
+					delete rebuilds[i];
+					rebuilds.erase( rebuilds.begin() + i );
+					break;
+				}
+			}
+
+			rebuild* r = new rebuild;
+			r->key = v->first;
+			r->previous = v->second.program;
+			if ( !startBuild( r->build, v->second.filenames[0].c_str(),
+					  v->second.filenames[1].c_str(), v->second.defines.c_str(),
+					  r->previous ) ) {
+				delete r;
+				continue;
+			}
+			rebuilds.push_back( r );
+		}
+
+		for ( size_t i = 0; i < rebuilds.size(); ++i ) {
+			if ( !isBuilt( rebuilds[i]->build ) ) {
+				return false;
+			}
+		}
+
+		bool isReplaced = false;
+		for ( size_t i = 0; i < rebuilds.size(); ++i ) {
+			rebuild* r = rebuilds[i];
+			if ( !checkBuild( r->build ) ) {
+				std::cerr << "Keeping the previous " << r->build.filenames[0] << " and "
+					  << r->build.filenames[1] << std::endl;
+				discardBuild( r->build );
+				delete r;
+				continue;
+			}
+
+			copyProgramState( r->build.program, r->previous );
+			Program rebuilt( r->build.program );
+			for ( size_t j = 0; j < targets.size(); ++j ) {
+				if ( *targets[j] == r->previous ) {
+					*targets[j] = rebuilt;
+				}
+			}
+			variant& v = variants[r->key];
+			v.program = r->build.program;
+			v.dependencies = r->build.dependencies;
+			glDeleteProgram( r->previous );
+			isReplaced = true;
+			delete r;
+		}
+		rebuilds.clear();
+
+		if ( isReplaced ) {
+			glUseProgram( 0 );
+		}
+		return isReplaced;
+	}
+
+
+	// Create a GLSL program object from vertex and fragment shader files,
+	//   loading it from the binary cache when the same sources were linked
+	//   by the same driver before
+	Program
+	InitShader(const char* vShaderFile, const char* fShaderFile)
+	{
+		Program program;
+		ProgramBatch batch;
+		batch.add( program, vShaderFile, fShaderFile );
+		batch.finish();
+
 		/* use program object */
 		glUseProgram(program);
 
@@ -0,0 +1,77 @@
+// writes sphere_baked.h: a subdivided tetrahedron, already packed in one
+//   vertex layout, and its levels of detail as constexpr arrays, so the
+//   game can hand the ball straight to glBufferData() without doing any
+//   geometry work at startup
+//
+// usage: bakesphere.out [firstLevel] [level] [layout] > sphere_baked.h
+
+#include "sphere.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+int main( int argc, char **argv )
+{
+	int firstLevel = argc > 1 ? atoi(argv[1]) : 1;
+	int level = argc > 2 ? atoi(argv[2]) : 6;
+	int layout = SphereHalf;
+	if (argc > 3){
+		layout = 0;
+		while (layout < NumSphereLayouts && strcmp(argv[3], SphereLayoutNames[layout]) != 0){
+			layout++;
+		}
+		if (layout == NumSphereLayouts){
+			fprintf(stderr, "Unknown layout %s\n", argv[3]);
+			return EXIT_FAILURE;
+		}
+	}
+	if (firstLevel < 0 || firstLevel > level){
+		fprintf(stderr, "First level %d is not between 0 and %d\n", firstLevel, level);
+		return EXIT_FAILURE;
+	}
+	sphereMesh ball = tetrahedron(level, firstLevel);
+	sphereVertices packed = packSphere(sphereLayout(layout), ball.points.data(),
+		ball.normals.data(), ball.points.size());
+
+	if (ball.points.size() > 65536){
+		fprintf(stderr, "Level %d has too many vertices for 16-bit indices\n", level);
+		return EXIT_FAILURE;
+	}
+
+	printf("// generated by bakesphere.out %d %d %s -- do not edit\n\n", firstLevel, level,
+		SphereLayoutNames[layout]);
+	printf("#ifndef __SPHERE_BAKED_H__\n#define __SPHERE_BAKED_H__\n\n");
+	printf("#include \"sphere.h\"\n\n");
+
+	printf("const int BakedSphereLevel = %d;\n", level);
+	printf("const int BakedSphereFirstLevel = %d;\n", firstLevel);
+	printf("const sphereLayout BakedSphereLayout = sphereLayout(%d);\t// %s\n", layout,
+		SphereLayoutNames[layout]);
+	printf("const int BakedSphereNumPoints = %zu;\n", ball.points.size());
+	printf("const int BakedSphereNumIndices = %zu;\n", ball.indices.size());
+	printf("const int BakedSphereNumLods = %zu;\n\n", ball.lods.size());
+
+	printf("constexpr sphereLOD BakedSphereLods[] = {\n");
+	for (size_t i = 0; i < ball.lods.size(); i++){
+		const sphereLOD& lod = ball.lods[i];
+		printf("\t{ %d, %u, %u },\n", lod.level, lod.first, lod.count);
+	}
+	printf("};\n\n");
+
+	// The vertices as packSphere() lays them out, to upload as they are
+	printf("alignas(4) constexpr GLubyte BakedSphereVertices[] = {");
+	for (size_t i = 0; i < packed.data.size(); i++){
+		printf("%s%u,", i % 16 == 0 ? "\n\t" : " ", packed.data[i]);
+	}
+	printf("\n};\n\n");
+
+	printf("constexpr GLushort BakedSphereIndices[] = {");
+	for (size_t i = 0; i < ball.indices.size(); i++){
+		printf("%s%u,", i % 12 == 0 ? "\n\t" : " ", ball.indices[i]);
+	}
+	printf("\n};\n\n");
+
+	printf("#endif // __SPHERE_BAKED_H__\n");
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,279 @@
+// microbenchmarks for the Angel math library, the sphere generator and
+//   shader loading
+//
+// Output is one tab-separated line per benchmark, preceded by a header:
+//   name  ns/op  ops/s  allocs/op
+// For the batch kernels and vertex packing one op is one point, and for the
+//   render queue one queued draw.  A second
+//   table gives the size of each of the ball's vertex layouts.
+//
+// usage: bench.out [prefix...]
+//   runs only the benchmarks whose names start with one of the prefixes,
+//   or every benchmark if none are given
+
+#include "Angel.h"
+#include "sphere.h"
+#include "renderqueue.h"
+#include <iostream>
+#include <cstdlib>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <atomic>
+#include <new>
+
+typedef std::chrono::steady_clock benchClock;
+
+// Constants
+const size_t NumPoints = 12288;	// one point per corner of the level 5 ball
+const double MinSecondsPerBench = 0.25;
+
+// Keeps the optimizer from discarding the benchmarked work
+volatile float sink;
+
+// Incremented by every call to operator new or new[]
+std::atomic<size_t> allocations(0);
+
+// Name prefixes of the benchmarks to run, or empty to run them all
+std::vector<std::string> selected;
+
+// Functional Prototypes
+void* countedAllocate( size_t );
+void countedFree( void* );
+bool isSelected( const char* );
+template <typename F> void bench( const char*, F, size_t );
+
+// -----------------------------------------------
+// -------------- F U N C T I O N S --------------
+// -----------------------------------------------
+
+// Every replaced operator new and delete goes through this pair, so that
+//   the compiler sees each allocation freed by its own kind of function
+void* countedAllocate( size_t size ){
+	allocations++;
+	void* p = malloc(size ? size : 1);
+	if (p == NULL){
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+void countedFree( void* p ){
+	free(p);
+}
+
+void* operator new( size_t size ){
+	return countedAllocate(size);
+}
+
+void* operator new[]( size_t size ){
+	return countedAllocate(size);
+}
+
+void operator delete( void* p ) noexcept{
+	countedFree(p);
+}
+
+void operator delete[]( void* p ) noexcept{
+	countedFree(p);
+}
+
+void operator delete( void* p, size_t ) noexcept{
+	countedFree(p);
+}
+
+void operator delete[]( void* p, size_t ) noexcept{
+	countedFree(p);
+}
+
+//----------------------------------------------------------------------------
+
+bool isSelected( const char* name ){
+	if (selected.empty()){
+		return true;
+	}
+	for (size_t i = 0; i < selected.size(); i++){
+		if (std::string(name).compare(0, selected[i].size(), selected[i]) == 0){
+			return true;
+		}
+	}
+	return false;
+}
+
+//----------------------------------------------------------------------------
+
+// Runs f, which performs opsPerCall ops, in doubling batches until a batch
+//   takes at least MinSecondsPerBench, then reports the last batch
+template <typename F>
+void bench( const char* name, F f, size_t opsPerCall ){
+	if (!isSelected(name)){
+		return;
+	}
+
+	size_t calls = 1;
+	double elapsed = 0.0;
+	size_t allocs = 0;
+
+	f();	// warm up caches and any lazily allocated state
+
+	while (true){
+		size_t allocsBegin = allocations;
+		benchClock::time_point begin = benchClock::now();
+		for (size_t i = 0; i < calls; i++){
+			f();
+		}
+		elapsed = std::chrono::duration<double>(benchClock::now() - begin).count();
+		allocs = allocations - allocsBegin;
+
+		if (elapsed >= MinSecondsPerBench){
+			break;
+		}
+		calls *= 2;
+	}
+
+	double ops = double(calls) * opsPerCall;
+	std::cout << name << "\t" << elapsed * 1e9 / ops << "\t" << ops / elapsed
+		<< "\t" << allocs / ops << std::endl;
+}
+
+//----------------------------------------------------------------------------
+
+int main( int argc, char **argv )
+{
+	selected.assign(argv + 1, argv + argc);
+
+	std::vector<point4> points4(NumPoints), pointsOut(NumPoints);
+	std::vector<vec3> normals3(NumPoints), normalsOut(NumPoints);
+
+	for (size_t i = 0; i < NumPoints; i++){
+		points4[i] = point4(rand()/float(RAND_MAX), rand()/float(RAND_MAX),
+			rand()/float(RAND_MAX), 1.0);
+		normals3[i] = vec3(points4[i].x, points4[i].y, points4[i].z);
+	}
+
+	mat4 m = RotateY(30.0) * Scale(1.0, 2.0, 1.0) * Translate(0.0, 0.0, -8.0);
+	mat4 rotation = RotateX(1.0) * RotateY(2.0);
+	mat4 acc;
+	float t = 0.0;
+
+	std::cout << "name\tns/op\tops/s\tallocs/op" << std::endl;
+
+	// Each product feeds the next, so this measures latency
+	bench("mat4_multiply", [&](){
+		acc = acc * rotation;
+		sink = acc[0][0];
+	}, 1);
+
+	bench("mat4_times_vec4", [&](){
+		pointsOut[0] = acc * pointsOut[0];
+		sink = pointsOut[0].x;
+	}, 1);
+
+	bench("LookAt", [&](){
+		t += 0.001;
+		sink = LookAt(point4(t, 0.0, 0.0, 1.0), point4(0.0, 0.0, -1.0, 1.0),
+			vec4(0.0, 1.0, 0.0, 0.0))[0][3];
+	}, 1);
+
+	bench("Perspective", [&](){
+		t += 0.001;
+		sink = Perspective(150.0 + t, 4.0/3.0, 2.0, 12.0)[0][0];
+	}, 1);
+
+	bench("normalize_vec3", [&](){
+		normalsOut[0] = normalize(normalsOut[0] + normals3[1]);
+		sink = normalsOut[0].x;
+	}, 1);
+
+	bench("cross_vec3", [&](){
+		normalsOut[0] = cross(normalsOut[0], normals3[1]) + normals3[2];
+		sink = normalsOut[0].x;
+	}, 1);
+
+	// Element-by-element mat4 * vec4, the only option before the kernels
+	bench("mat4_times_vec4_loop", [&](){
+		for (size_t i = 0; i < NumPoints; i++){
+			pointsOut[i] = m * points4[i];
+		}
+		sink = pointsOut[NumPoints - 1].x;
+	}, NumPoints);
+
+	bench("transformPoints", [&](){
+		transformPoints(m, points4.data(), pointsOut.data(), NumPoints);
+		sink = pointsOut[NumPoints - 1].x;
+	}, NumPoints);
+
+	bench("transformNormals", [&](){
+		transformNormals(m, normals3.data(), normalsOut.data(), NumPoints);
+		sink = normalsOut[NumPoints - 1].x;
+	}, NumPoints);
+
+	// Renormalizing already-unit vectors still does the full amount of work
+	bench("normalize_batch", [&](){
+		normalize(normalsOut.data(), NumPoints);
+		sink = normalsOut[NumPoints - 1].x;
+	}, NumPoints);
+
+	bench("tetrahedron_5", [&](){
+		sink = tetrahedron(5).points.back().x;
+	}, 1);
+
+	// The ball's level of detail chain, as baked into sphere_baked.h
+	bench("tetrahedron_lods_1_6", [&](){
+		sink = tetrahedron(6, 1).points.back().x;
+	}, 1);
+
+	bench("tetrahedron_8", [&](){
+		sink = tetrahedron(8).points.back().x;
+	}, 1);
+
+	// Packing the level 6 ball as the game does at startup
+	sphereMesh ball = tetrahedron(6);
+	for (int layout = SphereSeparate; layout <= SphereHalf; layout++){
+		std::string name = std::string("packSphere_") + SphereLayoutNames[layout];
+		bench(name.c_str(), [&](){
+			sink = packSphere(sphereLayout(layout), ball.points.data(),
+				ball.normals.data(), ball.points.size()).data.back();
+		}, ball.points.size());
+	}
+
+	// A frame's worth of scattered objects, sorted in place each time
+	const size_t NumDrawItems = 1024;
+	renderQueue queue;
+	queue.setMaxDistance(16.0);
+	for (size_t i = 0; i < NumDrawItems; i++){
+		drawItem item = { GLuint(rand() % 8), GLuint(rand() % 16), GLuint(rand() % 4),
+			GL_TRIANGLES, 3, 0, 0, NULL, 0, 0 };
+		queue.submit(item, renderPass(rand() % 2), 16.0 * rand() / RAND_MAX);
+	}
+	bench("renderQueue_sort", [&](){
+		sink = queue.sortOnly().program;
+	}, NumDrawItems);
+
+	bench("readShaderSource", [&](){
+		char* source = readShaderSource("fshader_lights.glsl");
+		if (source == NULL){
+			std::cerr << "Failed to read fshader_lights.glsl" << std::endl;
+			exit(EXIT_FAILURE);
+		}
+		sink = source[0];
+		delete [] source;
+	}, 1);
+
+	bench("ShaderSource", [&](){
+		ShaderSource source("fshader_lights.glsl");
+		if (!source.isValid()){
+			std::cerr << "Failed to find fshader_lights.glsl" << std::endl;
+			exit(EXIT_FAILURE);
+		}
+		sink = source.data()[0];
+	}, 1);
+
+	std::cout << std::endl << "layout\tbytes/vertex" << std::endl;
+	for (int layout = SphereSeparate; layout <= SphereHalf; layout++){
+		std::cout << SphereLayoutNames[layout] << "\t" << packSphere(sphereLayout(layout),
+			ball.points.data(), ball.normals.data(), 1).format.bytesPerVertex << std::endl;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,7 @@
+// Shared by every program and written by updateCamera() in project2.cpp.
+//   Shaders including this enable GL_ARB_uniform_buffer_object.
+layout(std140, row_major) uniform Camera {
+	mat4 viewMatrix;
+	mat4 projectionMatrix;
+	mat4 viewProjectionMatrix;
+};
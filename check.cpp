@@ -0,0 +1,299 @@
+// correctness checks for the Angel math library and the sphere generator
+//
+// The SSE products and batch kernels are compared with the scalar loops
+//   they replace, on random inputs, and spheres subdivided by two threads
+//   at once with one subdivided alone.  Prints one line per check and exits
+//   with failure if any result is off by more than Tolerance.
+
+#include "Angel.h"
+#include "sphere.h"
+#include <iostream>
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+#include <thread>
+#include <limits>
+
+// Constants
+const int NumTrials = 10000;
+const size_t NumPoints = 1027;	// not a multiple of 4, so the remainder runs too
+const GLfloat Tolerance = 1e-6;
+const GLfloat InverseTolerance = 1e-5;	// an inverse rounds more than a product
+const int ConcurrentLevel = 7;
+
+// A constant matrix is readable element by element at compile time
+constexpr mat4 QuarterTurn = ConstRotateZ(90.0);
+static_assert(QuarterTurn[1][0] > 0.999f && QuarterTurn[0][0] < 0.001f &&
+	QuarterTurn[3][3] == 1.0f, "ConstRotateZ(90) must turn x onto y");
+
+// Functional Prototypes
+GLfloat randomFloat( );
+mat4 randomMat4( );
+mat4 randomWellConditioned( );
+mat4 randomAffine( );
+vec4 randomVec4( );
+mat4 scalarProduct( const mat4&, const mat4& );
+vec4 scalarProduct( const mat4&, const vec4& );
+vec3 scalarProduct( const mat3&, const vec3& );
+mat3 upper3x3( const mat4& );
+GLfloat difference( const mat4&, const mat4& );
+GLfloat difference( const mat3&, const mat3& );
+GLfloat difference( const vec4&, const vec4& );
+GLfloat difference( const vec3&, const vec3& );
+GLfloat difference( const sphereMesh&, const sphereMesh& );
+bool report( const char*, GLfloat, GLfloat = Tolerance );
+
+// -----------------------------------------------
+// -------------- F U N C T I O N S --------------
+// -----------------------------------------------
+
+GLfloat randomFloat( ){
+	return 2.0 * rand() / RAND_MAX - 1.0;
+}
+
+mat4 randomMat4( ){
+	mat4 m;
+	for (int i = 0; i < 4; i++){
+		for (int j = 0; j < 4; j++){
+			m[i][j] = randomFloat();
+		}
+	}
+	return m;
+}
+
+// The identity plus small entries, far from singular
+mat4 randomWellConditioned( ){
+	return mat4() + 0.25 * randomMat4();
+}
+
+// A rotation, a scale and a translation, so the last row is ( 0, 0, 0, 1 )
+mat4 randomAffine( ){
+	return RotateX(180.0 * randomFloat()) * RotateY(180.0 * randomFloat()) *
+		Scale(1.5 + 0.5 * randomFloat(), 1.5 + 0.5 * randomFloat(), 1.5 + 0.5 * randomFloat()) *
+		Translate(4.0 * randomFloat(), 4.0 * randomFloat(), 4.0 * randomFloat());
+}
+
+vec4 randomVec4( ){
+	return vec4(randomFloat(), randomFloat(), randomFloat(), randomFloat());
+}
+
+//----------------------------------------------------------------------------
+
+// The products as the scalar loops compute them, in the same order
+
+mat4 scalarProduct( const mat4& a, const mat4& b ){
+	mat4 c( 0.0 );
+	for (int i = 0; i < 4; i++){
+		for (int j = 0; j < 4; j++){
+			for (int k = 0; k < 4; k++){
+				c[i][j] += a[i][k] * b[k][j];
+			}
+		}
+	}
+	return c;
+}
+
+vec4 scalarProduct( const mat4& m, const vec4& v ){
+	return vec4(m[0][0]*v.x + m[0][1]*v.y + m[0][2]*v.z + m[0][3]*v.w,
+		m[1][0]*v.x + m[1][1]*v.y + m[1][2]*v.z + m[1][3]*v.w,
+		m[2][0]*v.x + m[2][1]*v.y + m[2][2]*v.z + m[2][3]*v.w,
+		m[3][0]*v.x + m[3][1]*v.y + m[3][2]*v.z + m[3][3]*v.w);
+}
+
+vec3 scalarProduct( const mat3& m, const vec3& v ){
+	return vec3(m[0][0]*v.x + m[0][1]*v.y + m[0][2]*v.z,
+		m[1][0]*v.x + m[1][1]*v.y + m[1][2]*v.z,
+		m[2][0]*v.x + m[2][1]*v.y + m[2][2]*v.z);
+}
+
+mat3 upper3x3( const mat4& m ){
+	return mat3(vec3(m[0].x, m[0].y, m[0].z), vec3(m[1].x, m[1].y, m[1].z),
+		vec3(m[2].x, m[2].y, m[2].z));
+}
+
+//----------------------------------------------------------------------------
+
+// Largest difference between any two elements
+
+GLfloat difference( const mat4& a, const mat4& b ){
+	GLfloat d = 0.0;
+	for (int i = 0; i < 4; i++){
+		d = std::max(d, difference(a[i], b[i]));
+	}
+	return d;
+}
+
+GLfloat difference( const mat3& a, const mat3& b ){
+	GLfloat d = 0.0;
+	for (int i = 0; i < 3; i++){
+		d = std::max(d, difference(a[i], b[i]));
+	}
+	return d;
+}
+
+GLfloat difference( const vec4& a, const vec4& b ){
+	return std::max(std::max(std::fabs(a.x - b.x), std::fabs(a.y - b.y)),
+		std::max(std::fabs(a.z - b.z), std::fabs(a.w - b.w)));
+}
+
+GLfloat difference( const vec3& a, const vec3& b ){
+	return std::max(std::fabs(a.x - b.x), std::max(std::fabs(a.y - b.y),
+		std::fabs(a.z - b.z)));
+}
+
+// Meshes with different triangles differ by infinity
+GLfloat difference( const sphereMesh& a, const sphereMesh& b ){
+	if (a.points.size() != b.points.size() || a.indices != b.indices){
+		return std::numeric_limits<GLfloat>::infinity();
+	}
+	GLfloat d = 0.0;
+	for (size_t i = 0; i < a.points.size(); i++){
+		d = std::max(d, difference(a.points[i], b.points[i]));
+	}
+	return d;
+}
+
+//----------------------------------------------------------------------------
+
+bool report( const char* name, GLfloat maxDifference, GLfloat tolerance ){
+	bool isPassed = maxDifference <= tolerance;
+	std::cout << name << "\t" << (isPassed ? "ok" : "FAILED") << "\tmax difference "
+		<< maxDifference << std::endl;
+	return isPassed;
+}
+
+//----------------------------------------------------------------------------
+
+int main( )
+{
+	// Enough threads for the pool to be shared, however many the machine has
+	setenv("SPHERE_THREADS", "4", 0);
+
+	bool isPassed = true;
+
+	GLfloat maxDifference = 0.0;
+	for (int i = 0; i < NumTrials; i++){
+		mat4 a = randomMat4(), b = randomMat4();
+		maxDifference = std::max(maxDifference, difference(a * b, scalarProduct(a, b)));
+	}
+	isPassed &= report("mat4_multiply", maxDifference);
+
+	maxDifference = 0.0;
+	for (int i = 0; i < NumTrials; i++){
+		mat4 m = randomMat4();
+		vec4 v = randomVec4();
+		maxDifference = std::max(maxDifference, difference(m * v, scalarProduct(m, v)));
+	}
+	isPassed &= report("mat4_times_vec4", maxDifference);
+
+	maxDifference = 0.0;
+	for (int i = 0; i < NumTrials; i++){
+		vec4 u = randomVec4(), v = randomVec4();
+		vec4 product(u.x*v.x, u.y*v.y, u.z*v.z, u.w*v.w);
+		maxDifference = std::max(maxDifference, difference(u * v, product));
+		maxDifference = std::max(maxDifference,
+			std::abs(dot(u, v) - (product.x + product.y + product.z + product.w)));
+	}
+	isPassed &= report("vec4_product_dot", maxDifference);
+
+	maxDifference = 0.0;
+	for (int i = 0; i < NumTrials; i++){
+		Transform a(randomAffine()), b(randomAffine());
+		maxDifference = std::max(maxDifference, difference(mat4(a * b), mat4(a) * mat4(b)));
+	}
+	isPassed &= report("Transform_multiply", maxDifference);
+
+	maxDifference = 0.0;
+	for (int i = 0; i < NumTrials; i++){
+		Transform t(randomAffine());
+		maxDifference = std::max(maxDifference, difference(mat4(t * inverse(t)), mat4()));
+	}
+	isPassed &= report("Transform_inverse", maxDifference, InverseTolerance);
+
+	// The run-time rotations agree with the series the constant ones sum
+	maxDifference = 0.0;
+	for (int i = 0; i < NumTrials; i++){
+		GLfloat theta = 720.0 * randomFloat();
+		maxDifference = std::max(maxDifference, difference(RotateX(theta), ConstRotateX(theta)));
+		maxDifference = std::max(maxDifference, difference(RotateY(theta), ConstRotateY(theta)));
+		maxDifference = std::max(maxDifference, difference(RotateZ(theta), ConstRotateZ(theta)));
+	}
+	isPassed &= report("rotate_const", maxDifference);
+
+	maxDifference = 0.0;
+	for (int i = 0; i < NumTrials; i++){
+		mat4 m = randomWellConditioned();
+		mat4 mInverse = inverse(m);
+		maxDifference = std::max(maxDifference, difference(m * mInverse, mat4()));
+		maxDifference = std::max(maxDifference, difference(mInverse * m, mat4()));
+	}
+	isPassed &= report("inverse", maxDifference, InverseTolerance);
+
+	maxDifference = 0.0;
+	for (int i = 0; i < NumTrials; i++){
+		mat4 m = randomAffine();
+		maxDifference = std::max(maxDifference, difference(affineInverse(m), inverse(m)));
+	}
+	isPassed &= report("affineInverse", maxDifference, InverseTolerance);
+
+	// Only the upper-left 3x3 counts, so it is inverted on its own, padded
+	//   with the identity
+	maxDifference = 0.0;
+	for (int i = 0; i < NumTrials; i++){
+		mat4 m = randomWellConditioned();
+		mat4 linear = m;
+		linear[0].w = linear[1].w = linear[2].w = 0.0;
+		linear[3] = vec4(0.0, 0.0, 0.0, 1.0);
+		maxDifference = std::max(maxDifference,
+			difference(Normal(m), transpose(upper3x3(inverse(linear)))));
+	}
+	isPassed &= report("Normal", maxDifference, InverseTolerance);
+
+	mat4 m = randomMat4();
+	std::vector<vec4> points(NumPoints), pointsOut(NumPoints);
+	std::vector<vec3> normals(NumPoints), normalsOut(NumPoints);
+	for (size_t i = 0; i < NumPoints; i++){
+		points[i] = randomVec4();
+		normals[i] = vec3(randomFloat(), randomFloat(), randomFloat());
+	}
+
+	transformPoints(m, points.data(), pointsOut.data(), NumPoints);
+	maxDifference = 0.0;
+	for (size_t i = 0; i < NumPoints; i++){
+		maxDifference = std::max(maxDifference,
+			difference(pointsOut[i], scalarProduct(m, points[i])));
+	}
+	isPassed &= report("transformPoints", maxDifference);
+
+	// Normals are scaled by the inverse, so a well-conditioned matrix keeps
+	//   them within the tolerance
+	mat4 rigid = RotateX(30.0) * RotateY(45.0) * Translate(1.0, 2.0, 3.0);
+	transformNormals(rigid, normals.data(), normalsOut.data(), NumPoints);
+	mat3 N = Normal(rigid);
+	maxDifference = 0.0;
+	for (size_t i = 0; i < NumPoints; i++){
+		maxDifference = std::max(maxDifference,
+			difference(normalsOut[i], scalarProduct(N, normals[i])));
+	}
+	isPassed &= report("transformNormals", maxDifference);
+
+	normalsOut = normals;
+	normalize(normalsOut.data(), NumPoints);
+	maxDifference = 0.0;
+	for (size_t i = 0; i < NumPoints; i++){
+		GLfloat length = std::sqrt(dot(normals[i], normals[i]));
+		maxDifference = std::max(maxDifference, difference(normalsOut[i], normals[i] / length));
+	}
+	isPassed &= report("normalize_batch", maxDifference);
+
+	// Two threads subdividing at once take turns with the pool's threads
+	sphereMesh alone = tetrahedron(ConcurrentLevel, 1);
+	sphereMesh meshes[2];
+	std::thread other([&](){ meshes[1] = tetrahedron(ConcurrentLevel, 1); });
+	meshes[0] = tetrahedron(ConcurrentLevel, 1);
+	other.join();
+	isPassed &= report("tetrahedron_concurrent", std::max(difference(meshes[0], alone),
+		difference(meshes[1], alone)));
+
+	return isPassed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
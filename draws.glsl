@@ -0,0 +1,30 @@
+// Per-draw data of the objects the render queue draws together, written
+//   by renderQueue::flush() in renderqueue.cpp to match drawData in
+//   renderqueue.h, which injects MAX_DRAWS.  DRAW is this draw's entry,
+//   found by gl_DrawIDARB when HAS_DRAW_PARAMETERS is defined and
+//   otherwise by in_drawIndex, an instanced attribute counting up from
+//   the draw's baseInstance.  Vertex shaders including this enable
+//   GL_ARB_uniform_buffer_object, and GL_ARB_shader_draw_parameters if
+//   HAS_DRAW_PARAMETERS is defined.
+struct drawData {
+	mat4 modelView;
+	vec4 normalMatrix[3];	// rows
+	vec4 tint;	// multiplies the object's color
+	float textured;	// 1 to color by the texture, 0 by the vertices
+};
+
+layout(std140, row_major) uniform Draws {
+	drawData draws[MAX_DRAWS];
+};
+
+#ifdef HAS_DRAW_PARAMETERS
+#define DRAW draws[gl_DrawIDARB]
+#else
+in float in_drawIndex;
+#define DRAW draws[int(in_drawIndex)]
+#endif
+
+// DRAW's normal matrix times n; its rows are the columns of the mat3
+vec3 drawNormal( vec3 n ){
+	return n*mat3(DRAW.normalMatrix[0].xyz, DRAW.normalMatrix[1].xyz, DRAW.normalMatrix[2].xyz);
+}
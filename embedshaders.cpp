@@ -0,0 +1,72 @@
+// writes shaders_embedded.h: the source of every shader as a string in the
+//   binary, so the game reads no shader files and runs from any directory
+//
+// usage: embedshaders.out shader.glsl... > shaders_embedded.h
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+int main( int argc, char **argv )
+{
+	printf("// generated by embedshaders.out -- do not edit\n\n");
+	printf("#ifndef __SHADERS_EMBEDDED_H__\n#define __SHADERS_EMBEDDED_H__\n\n");
+	printf("#include <cstddef>\n\n");
+
+	printf("struct embeddedShader{\n");
+	printf("\tconst char* name;\n");
+	printf("\tconst char* source;\n");
+	printf("\tsize_t size;\n");
+	printf("};\n\n");
+
+	printf("const embeddedShader EmbeddedShaders[] = {\n");
+	for (int i = 1; i < argc; i++){
+		FILE* fp = fopen(argv[i], "rb");
+		if (fp == NULL){
+			fprintf(stderr, "Failed to read %s\n", argv[i]);
+			return EXIT_FAILURE;
+		}
+
+		// Shaders are looked up by file name, wherever they were built from
+		const char* name = strrchr(argv[i], '/');
+		name = name != NULL ? name + 1 : argv[i];
+		printf("\t{ \"%s\",", name);
+
+		// One string literal per line, escaped so it holds the bytes as is,
+		//   with ? escaped in case trigraphs are on
+		size_t size = 0;
+		bool isLineStart = true;
+		for (int c; (c = fgetc(fp)) != EOF; size++){
+			if (isLineStart){
+				printf("\n\t\t\"");
+				isLineStart = false;
+			}
+			if (c == '\n'){
+				printf("\\n\"");
+				isLineStart = true;
+			}
+			else if (c == '"' || c == '\\' || c == '?'){
+				printf("\\%c", c);
+			}
+			else if (c < ' ' || c > '~'){
+				printf("\\%03o", c);
+			}
+			else {
+				putchar(c);
+			}
+		}
+		if (size == 0){
+			printf(" \"");
+		}
+		if (!isLineStart || size == 0){
+			printf("\"");
+		}
+		printf(",\n\t\t%zu },\n", size);
+		fclose(fp);
+	}
+	printf("};\n\n");
+
+	printf("const size_t NumEmbeddedShaders = %d;\n\n", argc - 1);
+	printf("#endif // __SHADERS_EMBEDDED_H__\n");
+	return EXIT_SUCCESS;
+}
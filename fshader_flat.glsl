@@ -0,0 +1,13 @@
+#version 130
+
+out vec4 out_color;
+
+in vec4 pass_color;
+in vec2 f_texcoord;
+flat in vec4 f_tint;
+flat in float f_textured;
+uniform sampler2D texture;
+
+void main(){
+  out_color = mix(pass_color, texture2D(texture, f_texcoord), f_textured)*f_tint;
+}
@@ -0,0 +1,31 @@
+#version 130
+#extension GL_ARB_uniform_buffer_object : require
+
+#include "camera.glsl"
+#include "lights.glsl"
+
+in  vec3 fRay;
+in  vec3 fCenter;
+flat in vec4 fTint;
+
+out vec4 fColor;
+uniform float Radius;
+
+void main(){
+	// Nearest point where the ray from the eye through this fragment hits
+	//   the sphere, if it does
+	vec3 D = normalize(fRay);
+	float b = dot(D, fCenter);
+	float disc = b*b - dot(fCenter, fCenter) + Radius*Radius;
+	if( disc < 0.0 ) {
+		discard;
+	}
+	vec3 position = (b - sqrt(disc))*D;
+	vec3 normal = (position - fCenter)/Radius;
+
+	vec4 clip = projectionMatrix*vec4(position, 1.0);
+	gl_FragDepth = 0.5*(gl_DepthRange.diff*clip.z/clip.w + gl_DepthRange.near + gl_DepthRange.far);
+
+	// Lit as fshader_lights.glsl lights the mesh
+	fColor = shade( normal, normalize(position), position, fTint );
+}
@@ -1,8 +0,0 @@
-#version 130
-
-in vec4 pass_color;
-out vec4 out_color;
-
-void main(){
-  out_color=pass_color;
-}
@@ -0,0 +1,135 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  --- glstate.h ---
+//
+//   Cache of the GL binds and switches made while drawing, which skips
+//     calls that would set what is already set
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef __GLSTATE_H__
+#define __GLSTATE_H__
+
+#include "Angel.h"
+
+//  Texture units whose GL_TEXTURE_2D binding is tracked
+const int MaxTrackedTextureUnits = 8;
+
+//  Once GL state has been changed without going through the cache, call
+//    invalidate() so that the next call of each kind is made regardless.
+class glStateCache{
+	// Stands for state that isn't known, so never matches a real value
+	static const GLuint Unknown = ~GLuint(0);
+
+	GLuint program;
+	GLuint vertexArray;
+	GLenum activeUnit;
+	GLuint textures[MaxTrackedTextureUnits];
+	GLuint blend;		// GL_TRUE, GL_FALSE or Unknown
+	GLenum blendSrc, blendDst;
+	GLuint depthMask;	// GL_TRUE, GL_FALSE or Unknown
+
+	unsigned long frameSuppressed;
+
+	// Counts a call that was skipped, and returns whether it was
+	bool isSame( GLuint current, GLuint wanted ){
+		if (current == wanted){
+			frameSuppressed++;
+			return true;
+		}
+		return false;
+	}
+
+public:
+	unsigned long totalSuppressed;
+	unsigned long frames;
+
+	glStateCache() : frameSuppressed(0), totalSuppressed(0), frames(0){
+		invalidate();
+	}
+
+	void invalidate( ){
+		program = vertexArray = Unknown;
+		activeUnit = Unknown;
+		for (int i = 0; i < MaxTrackedTextureUnits; i++){
+			textures[i] = Unknown;
+		}
+		blend = blendSrc = blendDst = Unknown;
+		depthMask = Unknown;
+	}
+
+	void useProgram( GLuint p ){
+		if (!isSame(program, p)){
+			program = p;
+			glUseProgram(p);
+		}
+	}
+
+	void bindVertexArray( GLuint vao ){
+		if (!isSame(vertexArray, vao)){
+			vertexArray = vao;
+			glBindVertexArray(vao);
+		}
+	}
+
+	void activeTexture( GLenum unit ){
+		if (!isSame(activeUnit, unit)){
+			activeUnit = unit;
+			glActiveTexture(unit);
+		}
+	}
+
+	//  Binds a GL_TEXTURE_2D texture to the active unit
+	void bindTexture2D( GLuint texture ){
+		int unit = activeUnit - GL_TEXTURE0;
+		if (activeUnit == Unknown || unit >= MaxTrackedTextureUnits){
+			glBindTexture(GL_TEXTURE_2D, texture);
+		}
+		else if (!isSame(textures[unit], texture)){
+			textures[unit] = texture;
+			glBindTexture(GL_TEXTURE_2D, texture);
+		}
+	}
+
+	void setBlend( bool isEnabled ){
+		GLuint wanted = isEnabled ? GL_TRUE : GL_FALSE;
+		if (!isSame(blend, wanted)){
+			blend = wanted;
+			if (isEnabled){
+				glEnable(GL_BLEND);
+			}
+			else {
+				glDisable(GL_BLEND);
+			}
+		}
+	}
+
+	void blendFunc( GLenum src, GLenum dst ){
+		if (blendSrc == src && blendDst == dst){
+			frameSuppressed++;
+			return;
+		}
+		blendSrc = src;
+		blendDst = dst;
+		glBlendFunc(src, dst);
+	}
+
+	void setDepthMask( bool isWritable ){
+		GLuint wanted = isWritable ? GL_TRUE : GL_FALSE;
+		if (!isSame(depthMask, wanted)){
+			depthMask = wanted;
+			glDepthMask(wanted);
+		}
+	}
+
+	//  Ends a frame, returning how many calls were skipped during it
+	unsigned long endFrame( ){
+		unsigned long suppressed = frameSuppressed;
+		totalSuppressed += frameSuppressed;
+		frameSuppressed = 0;
+		frames++;
+		return suppressed;
+	}
+};
+
+#endif // __GLSTATE_H__
@@ -0,0 +1,140 @@
+// lights in a uniform block, listed per screen tile
+
+#include "lights.h"
+#include <algorithm>
+#include <cstddef>
+
+//----------------------------------------------------------------------------
+
+lightSet::lightSet()
+	: materialAmbient(1.0, 1.0, 1.0, 1.0), materialDiffuse(1.0, 1.0, 1.0, 1.0),
+	  materialSpecular(1.0, 1.0, 1.0, 1.0), block(), ubo(0), isDirty(true)
+{
+}
+
+//----------------------------------------------------------------------------
+
+void lightSet::create( GLuint binding ){
+	glGenBuffers( 1,&ubo );
+	glBindBuffer( GL_UNIFORM_BUFFER,ubo );
+	glBufferData( GL_UNIFORM_BUFFER,sizeof(lightBlock),NULL,GL_DYNAMIC_DRAW );
+	glBindBufferBase( GL_UNIFORM_BUFFER,binding,ubo );
+}
+
+//----------------------------------------------------------------------------
+
+int lightSet::add( const lightSource& light ){
+	if (lights.size() == size_t(MaxLights)){
+		return -1;
+	}
+	lights.push_back( light );
+	isDirty = true;
+	return int(lights.size()) - 1;
+}
+
+//----------------------------------------------------------------------------
+
+void lightSet::move( int light, const vec4& position ){
+	lights[light].position = position;
+	isDirty = true;
+}
+
+//----------------------------------------------------------------------------
+
+void lightSet::setMaterial( const vec4& ambient, const vec4& diffuse,
+		const vec4& specular ){
+	materialAmbient = ambient;
+	materialDiffuse = diffuse;
+	materialSpecular = specular;
+	isDirty = true;
+}
+
+//----------------------------------------------------------------------------
+
+// Sets the mask of every tile, from the eye space positions in the block.
+//   A point light's reach is bounded by a box, whose corners are projected
+//   to find the tiles it covers.
+void lightSet::assignTiles( const mat4& projection, int width, int height ){
+	int tileSize = MinLightTileSize;
+	while (((width + tileSize - 1) / tileSize) * ((height + tileSize - 1) / tileSize) >
+			MaxLightTiles){
+		tileSize *= 2;
+	}
+	int tilesAcross = (width + tileSize - 1) / tileSize;
+	int tilesDown = (height + tileSize - 1) / tileSize;
+
+	block.tileSize = tileSize;
+	block.tilesAcross = tilesAcross;
+	std::fill( block.tileMasks, block.tileMasks + MaxLightTiles, 0 );
+
+	for (int i = 0; i < block.numLights; i++){
+		const vec4& light = block.positions[i];
+		GLuint bit = GLuint(1) << i;
+
+		int left = 0, right = tilesAcross - 1;
+		int bottom = 0, top = tilesDown - 1;
+		if (light.w != 0.0){
+			GLfloat range = light.w;
+			if (light.z - range >= 0.0){
+				continue;	// wholly behind the eye
+			}
+
+			// A light around the eye plane is taken to reach every tile
+			if (light.z + range < 0.0){
+				GLfloat minX = 1.0, maxX = -1.0, minY = 1.0, maxY = -1.0;
+				for (int corner = 0; corner < 8; corner++){
+					vec4 clip = projection * vec4(
+						light.x + (corner & 1 ? range : -range),
+						light.y + (corner & 2 ? range : -range),
+						light.z + (corner & 4 ? range : -range), 1.0 );
+					GLfloat x = clip.x / clip.w, y = clip.y / clip.w;
+					minX = std::min(minX, x);
+					maxX = std::max(maxX, x);
+					minY = std::min(minY, y);
+					maxY = std::max(maxY, y);
+				}
+				if (maxX < -1.0 || minX > 1.0 || maxY < -1.0 || minY > 1.0){
+					continue;	// off screen
+				}
+
+				left = std::max(0, int(0.5 * (minX + 1.0) * width) / tileSize);
+				right = std::min(tilesAcross - 1, int(0.5 * (maxX + 1.0) * width) / tileSize);
+				bottom = std::max(0, int(0.5 * (minY + 1.0) * height) / tileSize);
+				top = std::min(tilesDown - 1, int(0.5 * (maxY + 1.0) * height) / tileSize);
+			}
+		}
+
+		for (int y = bottom; y <= top; y++){
+			for (int x = left; x <= right; x++){
+				block.tileMasks[y * tilesAcross + x] |= bit;
+			}
+		}
+	}
+}
+
+//----------------------------------------------------------------------------
+
+void lightSet::update( const mat4& view, const mat4& projection, int width, int height ){
+	if (!isDirty){
+		return;
+	}
+	isDirty = false;
+
+	block.numLights = lights.size();
+	for (size_t i = 0; i < lights.size(); i++){
+		const lightSource& light = lights[i];
+		block.positions[i] = view * light.position;
+		block.positions[i].w = light.position.w == 0.0 ? 0.0 : light.range;
+		block.ambientProducts[i] = light.ambient * materialAmbient;
+		block.diffuseProducts[i] = light.diffuse * materialDiffuse;
+		block.specularProducts[i] = light.specular * materialSpecular;
+	}
+	assignTiles( projection, width, height );
+
+	// Only the tiles the screen has are uploaded
+	size_t tilesSize = block.tilesAcross * ((height + block.tileSize - 1) / block.tileSize) *
+		sizeof(GLuint);
+	glBindBuffer( GL_UNIFORM_BUFFER,ubo );
+	glBufferSubData( GL_UNIFORM_BUFFER,0,offsetof(lightBlock, tileMasks) + tilesSize,
+		&block );
+}
@@ -0,0 +1,57 @@
+// Written by lightSet::update() in lights.cpp, which injects MAX_LIGHTS and
+//   MAX_LIGHT_TILES.  Positions are in eye space, w being a point light's
+//   range or 0 for a direction, and the products are of each light with
+//   the shared material.  Shaders including this enable
+//   GL_ARB_uniform_buffer_object.
+layout(std140) uniform Lights {
+	vec4 lightPositions[MAX_LIGHTS];
+	vec4 ambientProducts[MAX_LIGHTS];
+	vec4 diffuseProducts[MAX_LIGHTS];
+	vec4 specularProducts[MAX_LIGHTS];
+	ivec4 lightGrid;	// lights, tile size in pixels, tiles across
+	uvec4 tileMasks[MAX_LIGHT_TILES / 4];	// bit i set if light i reaches the tile
+};
+
+uniform float Shininess;
+
+// Color of the point at eye space position, with normal N, seen along E,
+//   lit by the lights listed for this fragment's tile
+vec4 shade( vec3 N, vec3 E, vec3 position, vec4 tint ){
+	 ivec2 tileXY = ivec2(gl_FragCoord.xy) / lightGrid.y;
+	 int tile = min(tileXY.y*lightGrid.z + tileXY.x, MAX_LIGHT_TILES - 1);
+	 uint mask = tileMasks[tile / 4][tile % 4];
+
+	 vec4 color = vec4(0.0);
+	 for( int i = 0; i < lightGrid.x; i++ ) {
+		 if( (mask & (1u << uint(i))) == 0u ) {
+			 continue;
+		 }
+
+		 vec4 light = lightPositions[i];
+		 vec3 L = light.xyz;
+		 float fade = 1.0;
+		 if( light.w != 0.0 ) {
+			 L = light.xyz - position;
+			 fade = clamp(1.0 - length(L)/light.w, 0.0, 1.0);
+			 fade *= fade;
+		 }
+		 L = normalize(L);
+
+		 vec3 H = normalize( L + E );
+		 float Kd = max(dot(L, N), 0.0);
+		 float Ks = pow(max(dot(N, H), 0.0), Shininess);
+
+		 vec4 ambient = tint*ambientProducts[i];
+		 vec4 diffuse = Kd*tint*diffuseProducts[i];
+		 vec4 specular = Ks*specularProducts[i];
+
+		 // discard the specular highlight if the light's behind the vertex
+		 if( dot(L, N) < 0.0 ) {
+			 specular = vec4(0.0);
+		 }
+
+		 color += fade*(ambient + diffuse + specular);
+	 }
+	 color.a = 1.0;
+	 return color;
+}
@@ -0,0 +1,90 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  --- lights.h ---
+//
+//   Every light of the scene in one uniform block, with the screen split
+//     into tiles that each list the lights reaching them, so a fragment
+//     only loops over the lights that can affect it
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef __LIGHTS_H__
+#define __LIGHTS_H__
+
+#include "Angel.h"
+#include <vector>
+
+//  Lights a tile can list, one bit of its mask each
+const int MaxLights = 32;
+
+//  Tiles the screen may be split into.  Tiles start MinLightTileSize
+//    pixels square and double in size until the screen fits.
+const int MaxLightTiles = 1024;
+const int MinLightTileSize = 32;
+
+//  One light, in world coordinates
+struct lightSource{
+	vec4 position;	// w of 0 for a light infinitely far in that direction
+	vec4 ambient;
+	vec4 diffuse;
+	vec4 specular;
+	GLfloat range;	// how far a point light reaches, fading out on the way
+};
+
+//  Layout of the Lights block, std140, as declared by fshader_lights.glsl
+//    and fshader_impostor.glsl
+struct lightBlock{
+	vec4   positions[MaxLights];	// eye space, w the range or 0 for a direction
+	vec4   ambientProducts[MaxLights];
+	vec4   diffuseProducts[MaxLights];
+	vec4   specularProducts[MaxLights];
+	GLint  numLights;
+	GLint  tileSize;	// in pixels
+	GLint  tilesAcross;
+	GLint  unused;
+	GLuint tileMasks[MaxLightTiles];	// bit i set if light i reaches the tile
+};
+
+static_assert(sizeof(lightBlock) == (4 * MaxLights + 1) * 4 * sizeof(GLfloat) +
+	MaxLightTiles * sizeof(GLuint), "lightBlock must match the std140 layout of the Lights block");
+
+//  The material products are computed here, once per change, for the
+//    material every lit object shares; objects bring their own color as a
+//    tint that the shaders multiply the ambient and diffuse terms by.
+class lightSet{
+	std::vector<lightSource> lights;
+	vec4 materialAmbient, materialDiffuse, materialSpecular;
+
+	lightBlock block;
+	GLuint ubo;
+	bool isDirty;
+
+	void assignTiles( const mat4& projection, int width, int height );
+
+public:
+	lightSet();
+
+	//  Creates the uniform buffer and binds it to binding
+	void create( GLuint binding );
+
+	//  Adds light, returning its index, or -1 if there are MaxLights already
+	int add( const lightSource& light );
+
+	//  Moves light, as lights following objects do every frame
+	void move( int light, const vec4& position );
+
+	void setMaterial( const vec4& ambient, const vec4& diffuse,
+		const vec4& specular );
+
+	//  Marks the block for rebuilding, as when the camera or the viewport
+	//    changes
+	void invalidate() { isDirty = true; }
+
+	//  Rebuilds the block and uploads it, if anything changed since the last
+	//    update
+	void update( const mat4& view, const mat4& projection, int width, int height );
+
+	size_t size() const { return lights.size(); }
+};
+
+#endif // __LIGHTS_H__
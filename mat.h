@@ -10,6 +10,13 @@
 #include <cstdio>
 #include "vec.h"
 
+//  The mat4 products use SSE when it is available.  Define ANGEL_NO_SIMD
+//    before including Angel.h to force the original scalar loops.
+#if !defined(ANGEL_NO_SIMD) && (defined(__SSE__) || defined(_M_X64))
+#  define ANGEL_SIMD
+#  include <xmmintrin.h>
+#endif // ANGEL_SIMD
+
 namespace Angel {
 
 //----------------------------------------------------------------------------
@@ -17,7 +24,7 @@ namespace Angel {
 //  mat2 - 2D square matrix
 //
 
-class mat2 {
+class alignas(16) mat2 {
 
     vec2  _m[2];
 
@@ -26,42 +33,35 @@ class mat2 {
     //  --- Constructors and Destructors ---
     //
 
-    mat2( const GLfloat d = GLfloat(1.0) )  // Create a diagional matrix
-	{ _m[0].x = d;  _m[1].y = d;   }
+    constexpr mat2( const GLfloat d = GLfloat(1.0) )  // Create a diagional matrix
+	: _m{ vec2( d, 0.0 ), vec2( 0.0, d ) } {}
 
-    mat2( const vec2& a, const vec2& b )
-	{ _m[0] = a;  _m[1] = b;  }
+    constexpr mat2( const vec2& a, const vec2& b )
+	: _m{ a, b } {}
 
-    mat2( GLfloat m00, GLfloat m10, GLfloat m01, GLfloat m11 )
-	{ _m[0] = vec2( m00, m10 ); _m[1] = vec2( m01, m11 ); }
+    constexpr mat2( GLfloat m00, GLfloat m10, GLfloat m01, GLfloat m11 )
+	: _m{ vec2( m00, m10 ), vec2( m01, m11 ) } {}
         // old version
 	// { _m[0] = vec2( m00, m01 ); _m[1] = vec2( m10, m11 ); }
 
-    mat2( const mat2& m ) {
-	if ( *this != m ) {
-	    _m[0] = m._m[0];
-	    _m[1] = m._m[1];
-	} 
-    }
-
     //
     //  --- Indexing Operator ---
     //
 
     vec2& operator [] ( int i ) { return _m[i]; }
-    const vec2& operator [] ( int i ) const { return _m[i]; }
+    constexpr const vec2& operator [] ( int i ) const { return _m[i]; }
 
     //
     //  --- (non-modifying) Arithmatic Operators ---
     //
 
-    mat2 operator + ( const mat2& m ) const
+    constexpr mat2 operator + ( const mat2& m ) const
 	{ return mat2( _m[0]+m[0], _m[1]+m[1] ); }
 
-    mat2 operator - ( const mat2& m ) const
+    constexpr mat2 operator - ( const mat2& m ) const
 	{ return mat2( _m[0]-m[0], _m[1]-m[1] ); }
 
-    mat2 operator * ( const GLfloat s ) const 
+    constexpr mat2 operator * ( const GLfloat s ) const 
 	{ return mat2( s*_m[0], s*_m[1] ); }
 
     mat2 operator / ( const GLfloat s ) const {
@@ -77,7 +77,7 @@ class mat2 {
 	return *this * r;
     }
 
-    friend mat2 operator * ( const GLfloat s, const mat2& m )
+    friend constexpr mat2 operator * ( const GLfloat s, const mat2& m )
 	{ return m * s; }
 	
     mat2 operator * ( const mat2& m ) const {
@@ -200,51 +200,40 @@ class mat3 {
     //  --- Constructors and Destructors ---
     //
 
-    mat3( const GLfloat d = GLfloat(1.0) )  // Create a diagional matrix
-	{ _m[0].x = d;  _m[1].y = d;  _m[2].z = d;   }
+    constexpr mat3( const GLfloat d = GLfloat(1.0) )  // Create a diagional matrix
+	: _m{ vec3( d, 0.0, 0.0 ), vec3( 0.0, d, 0.0 ), vec3( 0.0, 0.0, d ) } {}
 
-    mat3( const vec3& a, const vec3& b, const vec3& c )
-	{ _m[0] = a;  _m[1] = b;  _m[2] = c;  }
+    constexpr mat3( const vec3& a, const vec3& b, const vec3& c )
+	: _m{ a, b, c } {}
 
-    mat3( GLfloat m00, GLfloat m10, GLfloat m20,
-	  GLfloat m01, GLfloat m11, GLfloat m21,
-	  GLfloat m02, GLfloat m12, GLfloat m22 ) 
-	{
-	    _m[0] = vec3( m00, m10, m20 );
-	    _m[1] = vec3( m01, m11, m21 );
-	    _m[2] = vec3( m02, m12, m22 );
+    constexpr mat3( GLfloat m00, GLfloat m10, GLfloat m20,
+		    GLfloat m01, GLfloat m11, GLfloat m21,
+		    GLfloat m02, GLfloat m12, GLfloat m22 )
+	: _m{ vec3( m00, m10, m20 ),
+	      vec3( m01, m11, m21 ),
+	      vec3( m02, m12, m22 ) } {}
 	    // _m[0] = vec3( m00, m01, m02 );
 	    // _m[1] = vec3( m10, m11, m12 );
 	    // _m[2] = vec3( m20, m21, m22 );
-	}
-
-    mat3( const mat3& m )
-	{
-	    if ( *this != m ) {
-		_m[0] = m._m[0];
-		_m[1] = m._m[1];
-		_m[2] = m._m[2];
-	    } 
-	}
 
     //
     //  --- Indexing Operator ---
     //
 
     vec3& operator [] ( int i ) { return _m[i]; }
-    const vec3& operator [] ( int i ) const { return _m[i]; }
+    constexpr const vec3& operator [] ( int i ) const { return _m[i]; }
 
     //
     //  --- (non-modifying) Arithmatic Operators ---
     //
 
-    mat3 operator + ( const mat3& m ) const
+    constexpr mat3 operator + ( const mat3& m ) const
 	{ return mat3( _m[0]+m[0], _m[1]+m[1], _m[2]+m[2] ); }
 
-    mat3 operator - ( const mat3& m ) const
+    constexpr mat3 operator - ( const mat3& m ) const
 	{ return mat3( _m[0]-m[0], _m[1]-m[1], _m[2]-m[2] ); }
 
-    mat3 operator * ( const GLfloat s ) const 
+    constexpr mat3 operator * ( const GLfloat s ) const 
 	{ return mat3( s*_m[0], s*_m[1], s*_m[2] ); }
 
     mat3 operator / ( const GLfloat s ) const {
@@ -260,7 +249,7 @@ class mat3 {
 	return *this * r;
     }
 
-    friend mat3 operator * ( const GLfloat s, const mat3& m )
+    friend constexpr mat3 operator * ( const GLfloat s, const mat3& m )
 	{ return m * s; }
 	
     mat3 operator * ( const mat3& m ) const {
@@ -381,7 +370,7 @@ mat3 transpose( const mat3& A ) {
 //  mat4.h - 4D square matrix
 //
 
-class mat4 {
+class alignas(16) mat4 {
 
     vec4  _m[4];
 
@@ -390,55 +379,44 @@ class mat4 {
     //  --- Constructors and Destructors ---
     //
 
-    mat4( const GLfloat d = GLfloat(1.0) )  // Create a diagional matrix
-	{ _m[0].x = d;  _m[1].y = d;  _m[2].z = d;  _m[3].w = d; }
-
-    mat4( const vec4& a, const vec4& b, const vec4& c, const vec4& d )
-	{ _m[0] = a;  _m[1] = b;  _m[2] = c;  _m[3] = d; }
-
-    mat4( GLfloat m00, GLfloat m10, GLfloat m20, GLfloat m30,
-	  GLfloat m01, GLfloat m11, GLfloat m21, GLfloat m31,
-	  GLfloat m02, GLfloat m12, GLfloat m22, GLfloat m32,
-	  GLfloat m03, GLfloat m13, GLfloat m23, GLfloat m33 )
-	{
-	    _m[0] = vec4( m00, m10, m20, m30 );
-	    _m[1] = vec4( m01, m11, m21, m31 );
-	    _m[2] = vec4( m02, m12, m22, m32 );
-	    _m[3] = vec4( m03, m13, m23, m33 );
+    constexpr mat4( const GLfloat d = GLfloat(1.0) )  // Create a diagional matrix
+	: _m{ vec4( d, 0.0, 0.0, 0.0 ), vec4( 0.0, d, 0.0, 0.0 ),
+	      vec4( 0.0, 0.0, d, 0.0 ), vec4( 0.0, 0.0, 0.0, d ) } {}
+
+    constexpr mat4( const vec4& a, const vec4& b, const vec4& c, const vec4& d )
+	: _m{ a, b, c, d } {}
+
+    constexpr mat4( GLfloat m00, GLfloat m10, GLfloat m20, GLfloat m30,
+		    GLfloat m01, GLfloat m11, GLfloat m21, GLfloat m31,
+		    GLfloat m02, GLfloat m12, GLfloat m22, GLfloat m32,
+		    GLfloat m03, GLfloat m13, GLfloat m23, GLfloat m33 )
+	: _m{ vec4( m00, m10, m20, m30 ),
+	      vec4( m01, m11, m21, m31 ),
+	      vec4( m02, m12, m22, m32 ),
+	      vec4( m03, m13, m23, m33 ) } {}
 	    // _m[0] = vec4( m00, m01, m02, m03 );
 	    // _m[1] = vec4( m10, m11, m12, m13 );
 	    // _m[2] = vec4( m20, m21, m22, m23 );
 	    // _m[3] = vec4( m30, m31, m32, m33 );
-	}
-
-    mat4( const mat4& m )
-	{
-	    if ( *this != m ) {
-		_m[0] = m._m[0];
-		_m[1] = m._m[1];
-		_m[2] = m._m[2];
-		_m[3] = m._m[3];
-	    } 
-	}
 
     //
     //  --- Indexing Operator ---
     //
 
     vec4& operator [] ( int i ) { return _m[i]; }
-    const vec4& operator [] ( int i ) const { return _m[i]; }
+    constexpr const vec4& operator [] ( int i ) const { return _m[i]; }
 
     //
     //  --- (non-modifying) Arithematic Operators ---
     //
 
-    mat4 operator + ( const mat4& m ) const
+    constexpr mat4 operator + ( const mat4& m ) const
 	{ return mat4( _m[0]+m[0], _m[1]+m[1], _m[2]+m[2], _m[3]+m[3] ); }
 
-    mat4 operator - ( const mat4& m ) const
+    constexpr mat4 operator - ( const mat4& m ) const
 	{ return mat4( _m[0]-m[0], _m[1]-m[1], _m[2]-m[2], _m[3]-m[3] ); }
 
-    mat4 operator * ( const GLfloat s ) const 
+    constexpr mat4 operator * ( const GLfloat s ) const 
 	{ return mat4( s*_m[0], s*_m[1], s*_m[2], s*_m[3] ); }
 
     mat4 operator / ( const GLfloat s ) const {
@@ -454,12 +432,28 @@ class mat4 {
 	return *this * r;
     }
 
-    friend mat4 operator * ( const GLfloat s, const mat4& m )
+    friend constexpr mat4 operator * ( const GLfloat s, const mat4& m )
 	{ return m * s; }
 	
     mat4 operator * ( const mat4& m ) const {
 	mat4  a( 0.0 );
 
+#ifdef ANGEL_SIMD
+	// Row i of the product is the sum of the rows of m weighted by
+	//   the entries of our row i.
+	__m128  b0 = _mm_load_ps( m[0] );
+	__m128  b1 = _mm_load_ps( m[1] );
+	__m128  b2 = _mm_load_ps( m[2] );
+	__m128  b3 = _mm_load_ps( m[3] );
+
+	for ( int i = 0; i < 4; ++i ) {
+	    __m128  r = _mm_mul_ps( _mm_set1_ps(_m[i].x), b0 );
+	    r = _mm_add_ps( r, _mm_mul_ps( _mm_set1_ps(_m[i].y), b1 ) );
+	    r = _mm_add_ps( r, _mm_mul_ps( _mm_set1_ps(_m[i].z), b2 ) );
+	    r = _mm_add_ps( r, _mm_mul_ps( _mm_set1_ps(_m[i].w), b3 ) );
+	    _mm_store_ps( a[i], r );
+	}
+#else
 	for ( int i = 0; i < 4; ++i ) {
 	    for ( int j = 0; j < 4; ++j ) {
 		for ( int k = 0; k < 4; ++k ) {
@@ -467,6 +461,7 @@ class mat4 {
 		}
 	    }
 	}
+#endif // ANGEL_SIMD
 
 	return a;
     }
@@ -491,17 +486,7 @@ class mat4 {
     }
 
     mat4& operator *= ( const mat4& m ) {
-	mat4  a( 0.0 );
-
-	for ( int i = 0; i < 4; ++i ) {
-	    for ( int j = 0; j < 4; ++j ) {
-		for ( int k = 0; k < 4; ++k ) {
-		    a[i][j] += _m[i][k] * m[k][j];
-		}
-	    }
-	}
-
-	return *this = a;
+	return *this = *this * m;
     }
 
     mat4& operator /= ( const GLfloat s ) {
@@ -522,11 +507,26 @@ class mat4 {
     //
 
     vec4 operator * ( const vec4& v ) const {  // m * v
+#ifdef ANGEL_SIMD
+	// Multiply each row by v, then transpose so that a vertical sum
+	//   yields the four dot products at once.
+	__m128  x  = _mm_load_ps( v );
+	__m128  r0 = _mm_mul_ps( _mm_load_ps( _m[0] ), x );
+	__m128  r1 = _mm_mul_ps( _mm_load_ps( _m[1] ), x );
+	__m128  r2 = _mm_mul_ps( _mm_load_ps( _m[2] ), x );
+	__m128  r3 = _mm_mul_ps( _mm_load_ps( _m[3] ), x );
+	_MM_TRANSPOSE4_PS( r0, r1, r2, r3 );
+
+	vec4  c;
+	_mm_store_ps( c, _mm_add_ps( _mm_add_ps(r0, r1), _mm_add_ps(r2, r3) ) );
+	return c;
+#else
 	return vec4( _m[0][0]*v.x + _m[0][1]*v.y + _m[0][2]*v.z + _m[0][3]*v.w,
 		     _m[1][0]*v.x + _m[1][1]*v.y + _m[1][2]*v.z + _m[1][3]*v.w,
 		     _m[2][0]*v.x + _m[2][1]*v.y + _m[2][2]*v.z + _m[2][3]*v.w,
 		     _m[3][0]*v.x + _m[3][1]*v.y + _m[3][2]*v.z + _m[3][3]*v.w
 	    );
+#endif // ANGEL_SIMD
     }
 	
     //
@@ -576,6 +576,208 @@ mat4 transpose( const mat4& A ) {
 		 A[0][3], A[1][3], A[2][3], A[3][3] );
 }
 
+//  General inverse by cofactor expansion.  The 2x2 minors of the top and
+//    bottom row pairs are computed once and shared by all 16 cofactors,
+//    and the determinant is divided out with a single reciprocal.
+inline
+mat4 inverse( const mat4& a ) {
+    GLfloat s0 = a[0][0]*a[1][1] - a[0][1]*a[1][0];
+    GLfloat s1 = a[0][0]*a[1][2] - a[0][2]*a[1][0];
+    GLfloat s2 = a[0][0]*a[1][3] - a[0][3]*a[1][0];
+    GLfloat s3 = a[0][1]*a[1][2] - a[0][2]*a[1][1];
+    GLfloat s4 = a[0][1]*a[1][3] - a[0][3]*a[1][1];
+    GLfloat s5 = a[0][2]*a[1][3] - a[0][3]*a[1][2];
+
+    GLfloat c5 = a[2][2]*a[3][3] - a[2][3]*a[3][2];
+    GLfloat c4 = a[2][1]*a[3][3] - a[2][3]*a[3][1];
+    GLfloat c3 = a[2][1]*a[3][2] - a[2][2]*a[3][1];
+    GLfloat c2 = a[2][0]*a[3][3] - a[2][3]*a[3][0];
+    GLfloat c1 = a[2][0]*a[3][2] - a[2][2]*a[3][0];
+    GLfloat c0 = a[2][0]*a[3][1] - a[2][1]*a[3][0];
+
+    GLfloat det = s0*c5 - s1*c4 + s2*c3 + s3*c2 - s4*c1 + s5*c0;
+#ifdef DEBUG
+    if ( std::fabs(det) < DivideByZeroTolerance ) {
+	std::cerr << "[" << __FILE__ << ":" << __LINE__ << "] "
+		  << "Singular matrix" << std::endl;
+	return mat4();
+    }
+#endif // DEBUG
+
+    mat4  b(  a[1][1]*c5 - a[1][2]*c4 + a[1][3]*c3,
+	     -a[0][1]*c5 + a[0][2]*c4 - a[0][3]*c3,
+	      a[3][1]*s5 - a[3][2]*s4 + a[3][3]*s3,
+	     -a[2][1]*s5 + a[2][2]*s4 - a[2][3]*s3,
+
+	     -a[1][0]*c5 + a[1][2]*c2 - a[1][3]*c1,
+	      a[0][0]*c5 - a[0][2]*c2 + a[0][3]*c1,
+	     -a[3][0]*s5 + a[3][2]*s2 - a[3][3]*s1,
+	      a[2][0]*s5 - a[2][2]*s2 + a[2][3]*s1,
+
+	      a[1][0]*c4 - a[1][1]*c2 + a[1][3]*c0,
+	     -a[0][0]*c4 + a[0][1]*c2 - a[0][3]*c0,
+	      a[3][0]*s4 - a[3][1]*s2 + a[3][3]*s0,
+	     -a[2][0]*s4 + a[2][1]*s2 - a[2][3]*s0,
+
+	     -a[1][0]*c3 + a[1][1]*c1 - a[1][2]*c0,
+	      a[0][0]*c3 - a[0][1]*c1 + a[0][2]*c0,
+	     -a[3][0]*s3 + a[3][1]*s1 - a[3][2]*s0,
+	      a[2][0]*s3 - a[2][1]*s1 + a[2][2]*s0 );
+
+    return b * (GLfloat(1.0) / det);
+}
+
+//----------------------------------------------------------------------------
+//
+//  Transform - affine transformation stored as the top three rows of a mat4
+//
+//    The last row of an affine mat4 is always ( 0, 0, 0, 1 ), so it is not
+//    stored.  Composition and translation skip the work that row would
+//    cost, and the full mat4 is only built when it is needed, e.g. for
+//    glUniformMatrix4fv().
+//
+
+class Transform {
+
+    vec4  _m[3];
+
+   public:
+    //
+    //  --- Constructors and Destructors ---
+    //
+
+    constexpr Transform()  // Create an identity transformation
+	: _m{ vec4( 1.0, 0.0, 0.0, 0.0 ),
+	      vec4( 0.0, 1.0, 0.0, 0.0 ),
+	      vec4( 0.0, 0.0, 1.0, 0.0 ) } {}
+
+    constexpr explicit Transform( const vec3& t )  // Create a translation
+	: _m{ vec4( 1.0, 0.0, 0.0, t.x ),
+	      vec4( 0.0, 1.0, 0.0, t.y ),
+	      vec4( 0.0, 0.0, 1.0, t.z ) } {}
+
+    constexpr explicit Transform( const mat4& m )  // Drop the last row of m
+	: _m{ m[0], m[1], m[2] } {}
+
+    //
+    //  --- Indexing Operator ---
+    //
+
+    vec4& operator [] ( int i ) { return _m[i]; }
+    constexpr const vec4& operator [] ( int i ) const { return _m[i]; }
+
+    constexpr vec3 translation() const
+	{ return vec3( _m[0].w, _m[1].w, _m[2].w ); }
+
+    //
+    //  --- Composition ---
+    //
+
+    Transform operator * ( const Transform& t ) const {
+	Transform  a;
+
+	for ( int i = 0; i < 3; ++i ) {
+	    for ( int j = 0; j < 4; ++j ) {
+		a[i][j] = _m[i][0]*t[0][j] + _m[i][1]*t[1][j] + _m[i][2]*t[2][j];
+	    }
+	    a[i].w += _m[i].w;
+	}
+
+	return a;
+    }
+
+    Transform& operator *= ( const Transform& t )
+	{ return *this = *this * t; }
+
+    //  Equivalent to *this = *this * Translate( x, y, z ), without building
+    //    either matrix.
+    Transform& translate( const GLfloat x, const GLfloat y, const GLfloat z ) {
+	for ( int i = 0; i < 3; ++i ) {
+	    _m[i].w += _m[i].x*x + _m[i].y*y + _m[i].z*z;
+	}
+	return *this;
+    }
+
+    Transform& translate( const vec3& v )
+	{ return translate( v.x, v.y, v.z ); }
+
+    //
+    //  --- Transform / Vector operators ---
+    //
+
+    vec4 operator * ( const vec4& v ) const {  // t * v
+	return vec4( _m[0].x*v.x + _m[0].y*v.y + _m[0].z*v.z + _m[0].w*v.w,
+		     _m[1].x*v.x + _m[1].y*v.y + _m[1].z*v.z + _m[1].w*v.w,
+		     _m[2].x*v.x + _m[2].y*v.y + _m[2].z*v.z + _m[2].w*v.w,
+		     v.w );
+    }
+
+    //
+    //  --- Insertion Operator ---
+    //
+
+    friend std::ostream& operator << ( std::ostream& os, const Transform& t ) {
+	return os << std::endl
+		  << t[0] << std::endl
+		  << t[1] << std::endl
+		  << t[2] << std::endl;
+    }
+
+    //
+    //  --- Conversion Operators ---
+    //
+
+    operator mat4 () const
+	{ return mat4( _m[0], _m[1], _m[2], vec4( 0.0, 0.0, 0.0, 1.0 ) ); }
+};
+
+//
+//  --- Non-class Transform Methods ---
+//
+
+//  Inverts the linear part with cofactors and undoes the translation,
+//    which is far cheaper than a general 4x4 inverse.
+inline
+Transform inverse( const Transform& t ) {
+    GLfloat c00 = t[1][1]*t[2][2] - t[1][2]*t[2][1];
+    GLfloat c01 = t[1][2]*t[2][0] - t[1][0]*t[2][2];
+    GLfloat c02 = t[1][0]*t[2][1] - t[1][1]*t[2][0];
+
+    GLfloat det = t[0][0]*c00 + t[0][1]*c01 + t[0][2]*c02;
+#ifdef DEBUG
+    if ( std::fabs(det) < DivideByZeroTolerance ) {
+	std::cerr << "[" << __FILE__ << ":" << __LINE__ << "] "
+		  << "Singular transform" << std::endl;
+	return Transform();
+    }
+#endif // DEBUG
+    GLfloat r = GLfloat(1.0) / det;
+
+    Transform  a;
+    a[0].x = c00 * r;
+    a[0].y = (t[0][2]*t[2][1] - t[0][1]*t[2][2]) * r;
+    a[0].z = (t[0][1]*t[1][2] - t[0][2]*t[1][1]) * r;
+    a[1].x = c01 * r;
+    a[1].y = (t[0][0]*t[2][2] - t[0][2]*t[2][0]) * r;
+    a[1].z = (t[0][2]*t[1][0] - t[0][0]*t[1][2]) * r;
+    a[2].x = c02 * r;
+    a[2].y = (t[0][1]*t[2][0] - t[0][0]*t[2][1]) * r;
+    a[2].z = (t[0][0]*t[1][1] - t[0][1]*t[1][0]) * r;
+
+    for ( int i = 0; i < 3; ++i ) {
+	a[i].w = -( a[i].x*t[0].w + a[i].y*t[1].w + a[i].z*t[2].w );
+    }
+
+    return a;
+}
+
+//  Inverse of a mat4 whose last row is ( 0, 0, 0, 1 ), such as any product
+//    of Translate, Rotate and Scale matrices or a LookAt view matrix
+inline
+mat4 affineInverse( const mat4& m ) {
+    return mat4( inverse( Transform( m ) ) );
+}
+
 //////////////////////////////////////////////////////////////////////////////
 //
 //  Helpful Matrix Methods
@@ -599,45 +801,138 @@ vec4 mvmult( const mat4& a, const vec4& b )
     return c;
 }
 
+//----------------------------------------------------------------------------
+//
+//  Compile-time sine and cosine
+//
+//    std::sin() and std::cos() cannot be used in constant expressions, so
+//    the ConstRotate generators use these instead.  The angle is reduced to
+//    [-pi, pi] and the Taylor series is summed in double precision, which
+//    is exact to within float rounding.  At run time the Rotate generators
+//    call std::sin() and std::cos(), which are far cheaper.
+//
+
+inline constexpr
+double ReduceAngle( const double a )
+{
+    return a - 2.0*M_PI * static_cast<long long>( a/(2.0*M_PI) +
+						  (a < 0.0 ? -0.5 : 0.5) );
+}
+
+inline constexpr
+double SinSeries( const double x2, const double term, const int k )
+{
+    return k > 12 ? 0.0 :
+	term + SinSeries( x2, -term*x2 / ((2*k + 2)*(2*k + 3)), k + 1 );
+}
+
+inline constexpr
+double CosSeries( const double x2, const double term, const int k )
+{
+    return k > 12 ? 0.0 :
+	term + CosSeries( x2, -term*x2 / ((2*k + 1)*(2*k + 2)), k + 1 );
+}
+
+inline constexpr
+double ReducedSin( const double r )
+{
+    return SinSeries( r*r, r, 0 );
+}
+
+inline constexpr
+double ReducedCos( const double r )
+{
+    return CosSeries( r*r, 1.0, 0 );
+}
+
+inline constexpr
+GLfloat ConstSin( const double a )
+{
+    return ReducedSin( ReduceAngle(a) );
+}
+
+inline constexpr
+GLfloat ConstCos( const double a )
+{
+    return ReducedCos( ReduceAngle(a) );
+}
+
 //----------------------------------------------------------------------------
 //
 //  Rotation matrix generators
 //
+//    RotationX/Y/Z build the matrix from the angle's cosine and sine.
+//    Rotate* computes them with std::cos() and std::sin() and is for run
+//    time; ConstRotate* sums the series and is for constant expressions.
+//
+
+inline constexpr
+mat4 RotationX( const GLfloat c, const GLfloat s )
+{
+    return mat4( 1.0, 0.0, 0.0, 0.0,
+		 0.0,   c,  -s, 0.0,
+		 0.0,   s,   c, 0.0,
+		 0.0, 0.0, 0.0, 1.0 );
+}
+
+inline constexpr
+mat4 RotationY( const GLfloat c, const GLfloat s )
+{
+    return mat4(   c, 0.0,   s, 0.0,
+		 0.0, 1.0, 0.0, 0.0,
+		  -s, 0.0,   c, 0.0,
+		 0.0, 0.0, 0.0, 1.0 );
+}
+
+inline constexpr
+mat4 RotationZ( const GLfloat c, const GLfloat s )
+{
+    return mat4(   c,  -s, 0.0, 0.0,
+		   s,   c, 0.0, 0.0,
+		 0.0, 0.0, 1.0, 0.0,
+		 0.0, 0.0, 0.0, 1.0 );
+}
 
 inline
 mat4 RotateX( const GLfloat theta )
 {
     GLfloat angle = DegreesToRadians * theta;
-
-    mat4 c;
-    c[2][2] = c[1][1] = cos(angle);
-    c[2][1] = sin(angle);
-    c[1][2] = -c[2][1];
-    return c;
+    return RotationX( std::cos(angle), std::sin(angle) );
 }
 
 inline
 mat4 RotateY( const GLfloat theta )
 {
     GLfloat angle = DegreesToRadians * theta;
-
-    mat4 c;
-    c[2][2] = c[0][0] = cos(angle);
-    c[0][2] = sin(angle);
-    c[2][0] = -c[0][2];
-    return c;
+    return RotationY( std::cos(angle), std::sin(angle) );
 }
 
 inline
 mat4 RotateZ( const GLfloat theta )
 {
     GLfloat angle = DegreesToRadians * theta;
+    return RotationZ( std::cos(angle), std::sin(angle) );
+}
 
-    mat4 c;
-    c[0][0] = c[1][1] = cos(angle);
-    c[1][0] = sin(angle);
-    c[0][1] = -c[1][0];
-    return c;
+inline constexpr
+mat4 ConstRotateX( const GLfloat theta )
+{
+    return RotationX( ConstCos(DegreesToRadians*theta),
+		      ConstSin(DegreesToRadians*theta) );
+}
+
+inline constexpr
+mat4 ConstRotateY( const GLfloat theta )
+{
+    return RotationY( ConstCos(DegreesToRadians*theta),
+		      ConstSin(DegreesToRadians*theta) );
+}
+
+inline constexpr
+mat4 ConstRotateZ( const GLfloat theta )
+{
+    return RotationZ( ConstCos(DegreesToRadians*theta),
+		      ConstSin(DegreesToRadians*theta) );
 }
 
 //----------------------------------------------------------------------------
@@ -645,23 +940,22 @@ mat4 RotateZ( const GLfloat theta )
 //  Translation matrix generators
 //
 
-inline
+inline constexpr
 mat4 Translate( const GLfloat x, const GLfloat y, const GLfloat z )
 {
-    mat4 c;
-    c[0][3] = x;
-    c[1][3] = y;
-    c[2][3] = z;
-    return c;
+    return mat4( 1.0, 0.0, 0.0, x,
+		 0.0, 1.0, 0.0, y,
+		 0.0, 0.0, 1.0, z,
+		 0.0, 0.0, 0.0, 1.0 );
 }
 
-inline
+inline constexpr
 mat4 Translate( const vec3& v )
 {
     return Translate( v.x, v.y, v.z );
 }
 
-inline
+inline constexpr
 mat4 Translate( const vec4& v )
 {
     return Translate( v.x, v.y, v.z );
@@ -672,17 +966,16 @@ mat4 Translate( const vec4& v )
 //  Scale matrix generators
 //
 
-inline
+inline constexpr
 mat4 Scale( const GLfloat x, const GLfloat y, const GLfloat z )
 {
-    mat4 c;
-    c[0][0] = x;
-    c[1][1] = y;
-    c[2][2] = z;
-    return c;
+    return mat4( x,   0.0, 0.0, 0.0,
+		 0.0, y,   0.0, 0.0,
+		 0.0, 0.0, z,   0.0,
+		 0.0, 0.0, 0.0, 1.0 );
 }
 
-inline
+inline constexpr
 mat4 Scale( const vec3& v )
 {
     return Scale( v.x, v.y, v.z );
@@ -699,44 +992,39 @@ mat4 Scale( const vec3& v )
 
 
 
-inline
+inline constexpr
 mat4 Ortho( const GLfloat left, const GLfloat right,
 	    const GLfloat bottom, const GLfloat top,
 	    const GLfloat zNear, const GLfloat zFar )
 {
-    mat4 c;
-    c[0][0] = 2.0/(right - left);
-    c[1][1] = 2.0/(top - bottom);
-    c[2][2] = 2.0/(zNear - zFar);
-    c[3][3] = 1.0;
-    c[0][3] = -(right + left)/(right - left);
-    c[1][3] = -(top + bottom)/(top - bottom);
-    c[2][3] = -(zFar + zNear)/(zFar - zNear);
-    return c;
+    return mat4( 2.0/(right - left), 0.0, 0.0,
+		 -(right + left)/(right - left),
+		 0.0, 2.0/(top - bottom), 0.0,
+		 -(top + bottom)/(top - bottom),
+		 0.0, 0.0, 2.0/(zNear - zFar),
+		 -(zFar + zNear)/(zFar - zNear),
+		 0.0, 0.0, 0.0, 1.0 );
 }
 
-inline
+inline constexpr
 mat4 Ortho2D( const GLfloat left, const GLfloat right,
 	      const GLfloat bottom, const GLfloat top )
 {
     return Ortho( left, right, bottom, top, -1.0, 1.0 );
 }
 
-inline
+inline constexpr
 mat4 Frustum( const GLfloat left, const GLfloat right,
 	      const GLfloat bottom, const GLfloat top,
 	      const GLfloat zNear, const GLfloat zFar )
 {
-    mat4 c;
-    c[0][0] = 2.0*zNear/(right - left);
-    c[0][2] = (right + left)/(right - left);
-    c[1][1] = 2.0*zNear/(top - bottom);
-    c[1][2] = (top + bottom)/(top - bottom);
-    c[2][2] = -(zFar + zNear)/(zFar - zNear);
-    c[2][3] = -2.0*zFar*zNear/(zFar - zNear);
-    c[3][2] = -1.0;
-    c[3][3] = 0.0;
-    return c;
+    return mat4( 2.0*zNear/(right - left), 0.0,
+		 (right + left)/(right - left), 0.0,
+		 0.0, 2.0*zNear/(top - bottom),
+		 (top + bottom)/(top - bottom), 0.0,
+		 0.0, 0.0, -(zFar + zNear)/(zFar - zNear),
+		 -2.0*zFar*zNear/(zFar - zNear),
+		 0.0, 0.0, -1.0, 0.0 );
 }
 
 inline
@@ -765,8 +1053,8 @@ inline
 mat4 LookAt( const vec4& eye, const vec4& at, const vec4& up )
 {
     vec4 n = normalize(eye - at);
-    vec4 u = normalize(cross(up,n));
-    vec4 v = normalize(cross(n,u));
+    vec4 u = vec4(normalize(cross(up,n)), 0.0);
+    vec4 v = vec4(normalize(cross(n,u)), 0.0);
     vec4 t = vec4(0.0, 0.0, 0.0, 1.0);
     mat4 c = mat4(u, v, n, t);
     return c * Translate( -eye );
@@ -774,26 +1062,33 @@ mat4 LookAt( const vec4& eye, const vec4& at, const vec4& up )
 
 //----------------------------------------------------------------------------
 //
-// Generates a Normal Matrix
+// Generates a Normal Matrix: the inverse transpose of the upper-left 3x3
+//   of c, which keeps normals perpendicular to surfaces under non-uniform
+//   scaling.  Its rows are the cofactors of c divided by the determinant.
 //
 inline
 mat3 Normal( const mat4& c)
 {
-   mat3 d;
-   GLfloat det;
-   det = c[0][0]*c[1][1]*c[2][2]+c[0][1]*c[1][2]*c[2][1]
-     -c[2][0]*c[1][1]*c[0][2]-c[1][0]*c[0][1]*c[2][2]-c[0][0]*c[1][2]*c[2][1];
-   d[0][0] = (c[1][1]*c[2][2]-c[1][2]*c[2][1])/det;
-   d[0][1] = -(c[0][1]*c[2][2]-c[0][2]*c[2][1])/det;
-   d[0][2] = (c[0][1]*c[2][0]-c[2][1]*c[2][2])/det;
-   d[1][0] = -(c[0][1]*c[2][2]-c[0][2]*c[2][1])/det;
-   d[1][1] = (c[0][0]*c[2][2]-c[0][2]*c[2][0])/det;
-   d[1][2] = -(c[0][0]*c[2][1]-c[2][0]*c[0][1])/det;
-   d[2][0] = (c[0][1]*c[1][2]-c[1][1]*c[0][2])/det;
-   d[2][1] = -(c[0][0]*c[1][2]-c[0][2]*c[1][0])/det;
-   d[2][2] = (c[0][0]*c[1][1]-c[1][0]*c[0][1])/det;
+    mat3 d( c[1][1]*c[2][2] - c[1][2]*c[2][1],
+	    c[1][2]*c[2][0] - c[1][0]*c[2][2],
+	    c[1][0]*c[2][1] - c[1][1]*c[2][0],
+	    c[0][2]*c[2][1] - c[0][1]*c[2][2],
+	    c[0][0]*c[2][2] - c[0][2]*c[2][0],
+	    c[0][1]*c[2][0] - c[0][0]*c[2][1],
+	    c[0][1]*c[1][2] - c[0][2]*c[1][1],
+	    c[0][2]*c[1][0] - c[0][0]*c[1][2],
+	    c[0][0]*c[1][1] - c[0][1]*c[1][0] );
+
+    GLfloat det = c[0][0]*d[0][0] + c[0][1]*d[0][1] + c[0][2]*d[0][2];
+#ifdef DEBUG
+    if ( std::fabs(det) < DivideByZeroTolerance ) {
+	std::cerr << "[" << __FILE__ << ":" << __LINE__ << "] "
+		  << "Singular matrix" << std::endl;
+	return mat3();
+    }
+#endif // DEBUG
 
-  return d;
+    return d * (GLfloat(1.0) / det);
 }
 
 //----------------------------------------------------------------------------
@@ -820,15 +1115,186 @@ void printm(const mat4 a)
     printf("\n");
 }
 
-inline
+inline constexpr
 mat4 identity()
 {
-    mat4 c;
-    for(int i=0; i<4; i++) for(int j=0; j<4; j++) c[i][j]=0.0;
-    for(int i=0; i<4; i++) c[i][i] = 1.0;
-    return c;
+    return mat4();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  Batch transformation kernels
+//
+//    These work on whole arrays such as the points[] and normals[] arrays
+//    handed to glBufferData(), e.g. to bake static geometry into world
+//    space.  The SSE versions load four elements at a time, transpose them
+//    into x, y, z (and w) lanes, and transform all four at once; any
+//    remainder is handled by the scalar operators.  in and out may be the
+//    same array.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#ifdef ANGEL_SIMD
+//  Deinterleave four packed vec3s into x, y and z lanes.
+inline
+void loadVec3x4( const vec3* p, __m128& x, __m128& y, __m128& z )
+{
+    const GLfloat*  f = &p[0].x;
+    __m128  a = _mm_loadu_ps( f );	// x0 y0 z0 x1
+    __m128  b = _mm_loadu_ps( f + 4 );	// y1 z1 x2 y2
+    __m128  c = _mm_loadu_ps( f + 8 );	// z2 x3 y3 z3
+
+    x = _mm_shuffle_ps( _mm_shuffle_ps( a, a, _MM_SHUFFLE(3,3,3,0) ),
+			_mm_shuffle_ps( b, c, _MM_SHUFFLE(1,1,2,2) ),
+			_MM_SHUFFLE(2,0,1,0) );
+    y = _mm_shuffle_ps( _mm_shuffle_ps( a, b, _MM_SHUFFLE(0,0,1,1) ),
+			_mm_shuffle_ps( b, c, _MM_SHUFFLE(2,2,3,3) ),
+			_MM_SHUFFLE(2,0,2,0) );
+    z = _mm_shuffle_ps( _mm_shuffle_ps( a, b, _MM_SHUFFLE(1,1,2,2) ),
+			_mm_shuffle_ps( c, c, _MM_SHUFFLE(3,3,0,0) ),
+			_MM_SHUFFLE(2,0,2,0) );
+}
+
+//  Interleave x, y and z lanes back into four packed vec3s.
+inline
+void storeVec3x4( vec3* p, __m128 x, __m128 y, __m128 z )
+{
+    GLfloat*  f = &p[0].x;
+    _mm_storeu_ps( f,
+	_mm_shuffle_ps( _mm_unpacklo_ps( x, y ),
+			_mm_shuffle_ps( z, x, _MM_SHUFFLE(1,1,0,0) ),
+			_MM_SHUFFLE(2,0,1,0) ) );
+    _mm_storeu_ps( f + 4,
+	_mm_shuffle_ps( _mm_shuffle_ps( y, z, _MM_SHUFFLE(1,1,1,1) ),
+			_mm_shuffle_ps( x, y, _MM_SHUFFLE(2,2,2,2) ),
+			_MM_SHUFFLE(2,0,2,0) ) );
+    _mm_storeu_ps( f + 8,
+	_mm_shuffle_ps( _mm_shuffle_ps( z, x, _MM_SHUFFLE(3,3,2,2) ),
+			_mm_shuffle_ps( y, z, _MM_SHUFFLE(3,3,3,3) ),
+			_MM_SHUFFLE(2,0,2,0) ) );
+}
+#endif // ANGEL_SIMD
+
+//----------------------------------------------------------------------------
+
+//  out[i] = m * in[i]
+inline
+void transformPoints( const mat4& m, const vec4* in, vec4* out, size_t n )
+{
+    size_t  i = 0;
+
+#ifdef ANGEL_SIMD
+    __m128  c[4][4];
+    for ( int r = 0; r < 4; ++r ) {
+	for ( int k = 0; k < 4; ++k ) {
+	    c[r][k] = _mm_set1_ps( m[r][k] );
+	}
+    }
+
+    for ( ; i < (n & ~size_t(3)); i += 4 ) {
+	__m128  p[4] = { _mm_load_ps( in[i] ),     _mm_load_ps( in[i + 1] ),
+			 _mm_load_ps( in[i + 2] ), _mm_load_ps( in[i + 3] ) };
+	_MM_TRANSPOSE4_PS( p[0], p[1], p[2], p[3] );
+
+	__m128  q[4];
+	for ( int r = 0; r < 4; ++r ) {
+	    q[r] = _mm_add_ps(
+		_mm_add_ps( _mm_mul_ps( c[r][0], p[0] ), _mm_mul_ps( c[r][1], p[1] ) ),
+		_mm_add_ps( _mm_mul_ps( c[r][2], p[2] ), _mm_mul_ps( c[r][3], p[3] ) ) );
+	}
+	_MM_TRANSPOSE4_PS( q[0], q[1], q[2], q[3] );
+
+	for ( int k = 0; k < 4; ++k ) {
+	    _mm_store_ps( out[i + k], q[k] );
+	}
+    }
+#endif // ANGEL_SIMD
+
+    for ( ; i < n; ++i ) {
+	out[i] = m * in[i];
+    }
+}
+
+//  out[i] = N * in[i], where N is the inverse transpose of the upper-left
+//    3x3 of m.  The results are not renormalized; see normalize() below.
+inline
+void transformNormals( const mat4& m, const vec3* in, vec3* out, size_t n )
+{
+    mat3  N = Normal( m );
+
+    size_t  i = 0;
+
+#ifdef ANGEL_SIMD
+    __m128  c[3][3];
+    for ( int r = 0; r < 3; ++r ) {
+	for ( int k = 0; k < 3; ++k ) {
+	    c[r][k] = _mm_set1_ps( N[r][k] );
+	}
+    }
+
+    for ( ; i < (n & ~size_t(3)); i += 4 ) {
+	__m128  x, y, z;
+	loadVec3x4( in + i, x, y, z );
+
+	__m128  q[3];
+	for ( int r = 0; r < 3; ++r ) {
+	    q[r] = _mm_add_ps( _mm_add_ps( _mm_mul_ps( c[r][0], x ),
+					   _mm_mul_ps( c[r][1], y ) ),
+			       _mm_mul_ps( c[r][2], z ) );
+	}
+	storeVec3x4( out + i, q[0], q[1], q[2] );
+    }
+#endif // ANGEL_SIMD
+
+    for ( ; i < n; ++i ) {
+	out[i] = N * in[i];
+    }
 }
 
+//  Normalizes each of the n vectors in v in place
+inline
+void normalize( vec3* v, size_t n )
+{
+    size_t  i = 0;
+
+#ifdef ANGEL_SIMD
+    for ( ; i < (n & ~size_t(3)); i += 4 ) {
+	__m128  x, y, z;
+	loadVec3x4( v + i, x, y, z );
+
+	__m128  len = _mm_sqrt_ps( _mm_add_ps( _mm_add_ps( _mm_mul_ps( x, x ),
+							   _mm_mul_ps( y, y ) ),
+					       _mm_mul_ps( z, z ) ) );
+	storeVec3x4( v + i, _mm_div_ps( x, len ), _mm_div_ps( y, len ),
+		     _mm_div_ps( z, len ) );
+    }
+#endif // ANGEL_SIMD
+
+    for ( ; i < n; ++i ) {
+	v[i] = normalize( v[i] );
+    }
+}
+
+//----------------------------------------------------------------------------
+//
+//  Layout checks: matrices are passed straight to glUniformMatrix*fv() and
+//    copied with memcpy, so their size, alignment and triviality must not
+//    change.
+//
+
+static_assert( sizeof(mat2) == 4*sizeof(GLfloat), "mat2 must be packed" );
+static_assert( sizeof(mat3) == 9*sizeof(GLfloat), "mat3 must be packed" );
+static_assert( sizeof(mat4) == 16*sizeof(GLfloat), "mat4 must be packed" );
+static_assert( sizeof(Transform) == 12*sizeof(GLfloat),
+	       "Transform must be packed" );
+static_assert( alignof(mat4) == 16 && alignof(Transform) == 16,
+	       "mat4 and Transform must be 16-byte aligned" );
+static_assert( std::is_trivially_copyable<mat2>::value &&
+	       std::is_trivially_copyable<mat3>::value &&
+	       std::is_trivially_copyable<mat4>::value &&
+	       std::is_trivially_copyable<Transform>::value,
+	       "matrix types must be trivially copyable" );
+
 
 }  // namespace Angel
 
@@ -0,0 +1,42 @@
+// every static mesh in one vertex and one index buffer
+
+#include "meshbuffer.h"
+
+//----------------------------------------------------------------------------
+
+size_t meshBuffer::append( std::vector<piece>& pieces, size_t& total,
+		const void* data, size_t size ){
+	size_t offset = (total + 3) & ~size_t(3);
+	piece added = { data, offset, size };
+	pieces.push_back( added );
+	total = offset + size;
+	return offset;
+}
+
+//----------------------------------------------------------------------------
+
+// Sizes the buffer bound to target once, then fills in each piece
+void meshBuffer::fill( GLenum target, const std::vector<piece>& pieces,
+		size_t total ){
+	glBufferData( target,total,NULL,GL_STATIC_DRAW );
+	for (size_t i = 0; i < pieces.size(); i++){
+		if (pieces[i].size > 0){
+			glBufferSubData( target,pieces[i].offset,pieces[i].size,pieces[i].data );
+		}
+	}
+}
+
+//----------------------------------------------------------------------------
+
+void meshBuffer::upload( ){
+	glGenBuffers( 1,&vertexBuffer );
+	glBindBuffer( GL_ARRAY_BUFFER,vertexBuffer );
+	fill( GL_ARRAY_BUFFER,vertexPieces,vertexSize );
+
+	glGenBuffers( 1,&indexBuffer );
+	glBindBuffer( GL_ELEMENT_ARRAY_BUFFER,indexBuffer );
+	fill( GL_ELEMENT_ARRAY_BUFFER,indexPieces,indexSize );
+
+	std::vector<piece>().swap( vertexPieces );
+	std::vector<piece>().swap( indexPieces );
+}
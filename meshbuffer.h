@@ -0,0 +1,62 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  --- meshbuffer.h ---
+//
+//   One vertex buffer and one index buffer holding every static mesh, so
+//     that draws of different meshes share their buffers and can go out
+//     together as one multi-draw
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef __MESHBUFFER_H__
+#define __MESHBUFFER_H__
+
+#include "Angel.h"
+#include <vector>
+
+//  Meshes are added while the buffers are built, each add returning where
+//    the data will lie in its buffer, and upload() then creates both
+//    buffers at their final size and copies each mesh straight from where
+//    it was added from, so that data must stay alive until then.  Every
+//    addition starts on a 4 byte boundary, as GL prefers for attributes.
+class meshBuffer{
+	struct piece{
+		const void* data;
+		size_t      offset;
+		size_t      size;
+	};
+
+	std::vector<piece> vertexPieces, indexPieces;
+	size_t vertexSize, indexSize;
+	GLuint vertexBuffer, indexBuffer;
+
+	static size_t append( std::vector<piece>& pieces, size_t& total,
+		const void* data, size_t size );
+	static void fill( GLenum target, const std::vector<piece>& pieces,
+		size_t total );
+
+public:
+	meshBuffer() : vertexSize(0), indexSize(0), vertexBuffer(0), indexBuffer(0) {}
+
+	//  Adds size bytes of vertices, returning their offset in the vertex
+	//    buffer
+	size_t addVertices( const void* vertices, size_t size ){
+		return append( vertexPieces, vertexSize, vertices, size );
+	}
+
+	//  Adds size bytes of indices, returning their offset in the index
+	//    buffer
+	size_t addIndices( const void* indices, size_t size ){
+		return append( indexPieces, indexSize, indices, size );
+	}
+
+	//  Creates the buffers from everything added, and forgets it.  The
+	//    index buffer is left bound to GL_ELEMENT_ARRAY_BUFFER, which
+	//    records it in the bound vertex array.
+	void upload( );
+
+	GLuint vertices() const { return vertexBuffer; }
+	GLuint indices() const { return indexBuffer; }
+};
+
+#endif // __MESHBUFFER_H__
@@ -0,0 +1,165 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  --- program.h ---
+//
+//   Linked GLSL program with its active uniforms and attributes, looked up
+//     once when it is created
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef __ANGEL_PROGRAM_H__
+#define __ANGEL_PROGRAM_H__
+
+#include <map>
+#include <string>
+
+namespace Angel {
+
+//----------------------------------------------------------------------------
+//
+//  --- Uniform values ---
+//
+//   uniformType<T>::matches() tells which GLSL types a T may be stored in,
+//     and setUniform() stores one in the current program
+//
+
+template <typename T> struct uniformType;
+
+template <> struct uniformType<GLfloat>{
+    static bool matches( GLenum type ) { return type == GL_FLOAT; }
+};
+
+template <> struct uniformType<GLint>{
+    // Samplers are set to the texture unit they read from
+    static bool matches( GLenum type )
+	{ return type == GL_INT || type == GL_BOOL || type == GL_SAMPLER_2D; }
+};
+
+template <> struct uniformType<vec2>{
+    static bool matches( GLenum type ) { return type == GL_FLOAT_VEC2; }
+};
+
+template <> struct uniformType<vec3>{
+    static bool matches( GLenum type ) { return type == GL_FLOAT_VEC3; }
+};
+
+template <> struct uniformType<vec4>{
+    static bool matches( GLenum type ) { return type == GL_FLOAT_VEC4; }
+};
+
+template <> struct uniformType<mat3>{
+    static bool matches( GLenum type ) { return type == GL_FLOAT_MAT3; }
+};
+
+template <> struct uniformType<mat4>{
+    static bool matches( GLenum type ) { return type == GL_FLOAT_MAT4; }
+};
+
+inline void setUniform( GLint location, GLfloat v ) { glUniform1f( location, v ); }
+inline void setUniform( GLint location, GLint v ) { glUniform1i( location, v ); }
+inline void setUniform( GLint location, const vec2& v ) { glUniform2fv( location, 1, v ); }
+inline void setUniform( GLint location, const vec3& v ) { glUniform3fv( location, 1, v ); }
+inline void setUniform( GLint location, const vec4& v ) { glUniform4fv( location, 1, v ); }
+
+//  mat3 and mat4 are row-major, so GL transposes them
+inline void setUniform( GLint location, const mat3& m )
+    { glUniformMatrix3fv( location, 1, GL_TRUE, m ); }
+inline void setUniform( GLint location, const mat4& m )
+    { glUniformMatrix4fv( location, 1, GL_TRUE, m ); }
+
+//----------------------------------------------------------------------------
+//
+//  --- Uniform ---
+//
+//   Handle to one uniform of one program, holding a T.  Handles only come
+//     from Program::uniform(), which checks the type, so they can't be
+//     used with a different program or the wrong kind of value.  A
+//     uniform the program doesn't use has location -1, which GL ignores.
+//
+
+template <typename T>
+class Uniform {
+    GLint   location;
+    GLuint  program;
+
+    friend class Program;
+    Uniform( GLint location, GLuint program )
+	: location(location), program(program) {}
+
+   public:
+    Uniform() : location(-1), program(0) {}
+
+    //  Sets the uniform, whose program must be in use
+    void set( const T& value ) const {
+#ifdef DEBUG
+	GLint current;
+	glGetIntegerv( GL_CURRENT_PROGRAM, &current );
+	if ( GLuint(current) != program ) {
+	    std::cerr << "Uniform set while program " << current
+		      << " is in use instead of " << program << std::endl;
+	}
+#endif // DEBUG
+	if ( location >= 0 ) {
+	    setUniform( location, value );
+	}
+    }
+
+    bool isActive() const { return location >= 0; }
+};
+
+//----------------------------------------------------------------------------
+//
+//  --- Program ---
+//
+
+class Program {
+    //  An active uniform or attribute
+    struct variable {
+	GLint   location;
+	GLenum  type;
+    };
+
+    GLuint  id;
+    std::map<std::string, variable>  uniforms;
+    std::map<std::string, variable>  attribs;
+
+   public:
+    Program() : id(0) {}
+
+    //  Reads the active uniforms and attributes of the linked program id
+    explicit Program( GLuint id );
+
+    //  Programs convert to their GL name, for glUseProgram() and the like
+    operator GLuint() const { return id; }
+
+    //  Returns a handle to the uniform called name, which must hold a T if
+    //    the program uses it.  Uniform arrays are named without "[0]".
+    template <typename T>
+    Uniform<T> uniform( const char* name ) const {
+	std::map<std::string, variable>::const_iterator u = uniforms.find( name );
+	if ( u == uniforms.end() ) {
+	    return Uniform<T>( -1, id );
+	}
+	if ( !uniformType<T>::matches( u->second.type ) ) {
+	    std::cerr << "Uniform " << name << " of program " << id
+		      << " has a different type" << std::endl;
+	    exit( EXIT_FAILURE );
+	}
+	return Uniform<T>( u->second.location, id );
+    }
+
+    //  Location of the attribute called name, or -1 if it isn't used
+    GLint attrib( const char* name ) const {
+	std::map<std::string, variable>::const_iterator a = attribs.find( name );
+	return a == attribs.end() ? -1 : a->second.location;
+    }
+
+    //  Index of the uniform block called name, or GL_INVALID_INDEX
+    GLuint uniformBlock( const char* name ) const {
+	return glGetUniformBlockIndex( id, name );
+    }
+};
+
+}  // namespace Angel
+
+#endif // __ANGEL_PROGRAM_H__
@@ -1,6 +1,14 @@
 // fragment shading of sphere model
 
 #include "Angel.h"
+#include "sphere.h"
+#include "sphere_baked.h"
+#include "vertexformat.h"
+#include "glstate.h"
+#include "renderqueue.h"
+#include "streamring.h"
+#include "meshbuffer.h"
+#include "lights.h"
 #include <iostream>
 #include <cstdlib>
 #include "SDL2/SDL.h"
@@ -8,6 +16,9 @@
 #include <chrono>
 #include <thread>
 #include <cmath>
+#include <algorithm>
+#include <cstring>
+#include <cstddef>
 #include <math.h>
 
 typedef Angel::vec4 point4;
@@ -32,6 +43,7 @@ float DeflectionReductionFactor = 8.0;
 int MsPerFrame = 50;
 int WindowWidth = 768;
 int WindowHeight = 576;
+GLfloat FovY = 150.0;
 
 vec3 ballVel(VelInitial.x,VelInitial.y,VelInitial.z);
 int score = 0;
@@ -46,66 +58,113 @@ struct collisionInfo{
 
 } collision;
 
-//for angel sphere
-const int NumTimesToSubdivide = 5;
-const int NumTriangles        = 4096;  // (4 faces)^(NumTimesToSubdivide + 1)
-const int NumVertices         = 3 * NumTriangles;
-point4 points[NumVertices];
-vec3   normals[NumVertices];
-int Index = 0;
-
-// Model and view matrices uniform location
-GLuint  mMatrix, vMatrix, pMatrix;
-GLuint vaoP, vaoW, vaoB, eboP, eboW, eboB, vbo_cube_texcoords;
-GLuint programP, programW, programB;
+// Matrices derived from an object's model matrix and the view.  They are
+//   cached and only recomputed when isDirty is set by a change to either.
+struct derivedMatrices{
+	mat4 modelView;
+	mat3 normal;
+	bool isDirty;
+
+	derivedMatrices() : isDirty(true) {}
+
+} derivedB;
+
+// Camera matrices shared by every program through the std140 Camera
+//   uniform block, bound at CameraBinding.  The block declares them
+//   row_major, so they are stored as mat4 lays them out.  The buffer is
+//   only written when isDirty is set by a change to the view or window.
+struct cameraBlock{
+	mat4 view;
+	mat4 projection;
+	mat4 viewProjection;
+};
+
+struct cameraUniforms{
+	cameraBlock block;
+	GLuint ubo;
+	bool isDirty;
+
+	cameraUniforms() : ubo(0), isDirty(true) {}
+
+} camera;
+
+static_assert(sizeof(cameraBlock) == 3 * 16 * sizeof(GLfloat),
+	"cameraBlock must match the std140 layout of the Camera block");
+
+const GLuint CameraBinding = 0;
+
+// Every light, in the Lights uniform block bound at LightsBinding.  The
+//   key light shines from behind the eye, and the arena lights hang over
+//   the corners of the court.
+lightSet lights;
+const GLuint LightsBinding = 1;
+
+const lightSource ArenaLights[] = {
+	{ point4( -8.0, 6.0, -5.0, 1.0 ), color4( 0.0, 0.0, 0.0, 1.0 ),
+		color4( 1.0, 0.6, 0.3, 1.0 ), color4( 1.0, 0.6, 0.3, 1.0 ), 12.0 },
+	{ point4( 8.0, 6.0, -5.0, 1.0 ), color4( 0.0, 0.0, 0.0, 1.0 ),
+		color4( 0.3, 0.6, 1.0, 1.0 ), color4( 0.3, 0.6, 1.0, 1.0 ), 12.0 },
+	{ point4( -8.0, 6.0, -11.0, 1.0 ), color4( 0.0, 0.0, 0.0, 1.0 ),
+		color4( 0.3, 1.0, 0.5, 1.0 ), color4( 0.3, 1.0, 0.5, 1.0 ), 12.0 },
+	{ point4( 8.0, 6.0, -11.0, 1.0 ), color4( 0.0, 0.0, 0.0, 1.0 ),
+		color4( 1.0, 0.3, 0.8, 1.0 ), color4( 1.0, 0.3, 0.8, 1.0 ), 12.0 },
+};
+
+// Each object's transform and material reach its shaders through the
+//   Draws block, bound at DrawsBinding, where the render queue writes them
+const GLuint DrawsBinding = 2;
+
+// The paddle and wall share programS and vaoS, so they are drawn together
+GLuint vaoS, vaoB, vaoI, vaoBI;
+Program programS, programB, programI, programBI;
+ShaderWatcher shaderWatcher;
 GLuint texture_id;
-GLint attribute_texcoord;
-GLint uniform_mytexture;
-mat4 modelP, modelW, modelB;
+Transform modelP, modelW, modelB;
 
 // Create camera view variables
 point4 at( 0.0, 0.0, -1.0, 1.0 );
 point4 eye( 0.0, 0.0, 0.0, 1.0 );
 vec4   up( 0.0, 1.0, 0.0, 0.0 );
 
-GLfloat positionArray[]={
-	// Paddle
-	-2.0,-2.0,0.0,
-	-2.0,2.0,0.0,
-	2.0,2.0,0.0,
-	2.0,-2.0,0.0,
-
-	// Wall
-	-10.0,-7.0,0.0,
-	-10.0,7.0,0.0,
-	10.0,7.0,0.0,
-	10.0,-7.0,0.0
+// Paddle and wall corners, interleaved with their colors and texture
+//   positions
+struct staticVertex{
+	GLfloat position[3];
+	GLubyte color[4];
+	GLfloat texcoord[2];
 };
 
-GLfloat colorArray[]={
+staticVertex staticVertices[]={
 	// Paddle
-	1.0,0.0,0.0,0.5,
-	1.0,0.0,0.0,0.5,
-	1.0,0.0,0.0,0.5,
-	1.0,0.0,0.0,0.5,
+	{{-2.0,-2.0,0.0}, {255,0,0,128}, {0.0,0.0}},
+	{{-2.0,2.0,0.0},  {255,0,0,128}, {1.0,0.0}},
+	{{2.0,2.0,0.0},   {255,0,0,128}, {1.0,1.0}},
+	{{2.0,-2.0,0.0},  {255,0,0,128}, {0.0,1.0}},
 
 	// Wall
-	0.0,0.0,1.0,1.0,
-	0.0,0.0,1.0,1.0,
-	0.0,0.0,1.0,1.0,
-	0.0,0.0,1.0,1.0
+	{{-10.0,-7.0,0.0}, {0,0,255,255}, {0.0,0.0}},
+	{{-10.0,7.0,0.0},  {0,0,255,255}, {0.0,0.0}},
+	{{10.0,7.0,0.0},   {0,0,255,255}, {0.0,0.0}},
+	{{10.0,-7.0,0.0},  {0,0,255,255}, {0.0,0.0}}
 };
 
-GLubyte elemsArray[]={
-	0,1,2,3
+// Corners of the quad the ball impostor is drawn on, as a triangle fan
+GLfloat impostorCorners[]={
+	-1.0,-1.0,
+	1.0,-1.0,
+	1.0,1.0,
+	-1.0,1.0
 };
 
-GLfloat cube_texcoords[2*4*6] = {
-    // front
-	0.0, 0.0,
-	1.0, 0.0,
-	1.0, 1.0,
-	0.0, 1.0,
+vertexFormat staticFormat = interleaved({
+	{ "in_position", 3, GL_FLOAT,         GL_FALSE, 0, 0 },
+	{ "in_color",    4, GL_UNSIGNED_BYTE, GL_TRUE,  0, 0 },
+	{ "texcoord",    2, GL_FLOAT,         GL_FALSE, 0, 0 } });
+
+// The paddle's quad, then the wall's
+GLubyte elemsArray[]={
+	0,1,2,3,
+	4,5,6,7
 };
 
 // Define geometric Constants
@@ -114,7 +173,80 @@ GLfloat BallRadius = 0.5;
 GLfloat PaddleHeight = 4.0;
 GLfloat PaddleWidth = 4.0;
 
-size_t posDataOffset, colorDataOffset, normalsDataOffset, spherePosDataOffset;
+// Every object's vertices live in one vertex buffer, and their indices
+//   in one element buffer, at the byte offsets meshes gives them
+meshBuffer meshes;
+size_t ballIndexOffset, quadIndexOffset;
+
+// Whether the ball is ray-cast on a single quad instead of drawn as a
+//   mesh, toggled with the i key
+bool drawBallImpostor = false;
+
+// Finest level of the ball mesh, optionally overridden by the first
+//   command-line argument.  The baked mesh is used unless a different level
+//   is asked for.
+int NumTimesToSubdivide = BakedSphereLevel;
+// Ball vertex layout, optionally named by the second command-line argument.
+//   The baked mesh is only used in the layout it was baked in.
+sphereLayout BallLayout = BakedSphereLayout;
+size_t ballBytesPerVertex;
+
+// Time spent in display(), reported at exit to compare layouts
+double displaySeconds = 0.0;
+unsigned long framesDrawn = 0;
+unsigned long drawCalls = 0;
+
+// Every bind and switch made by display() goes through this
+glStateCache gl;
+
+// Objects drawn each frame, in the order their sort keys give
+renderQueue queue;
+
+// Data written each frame for that frame's draws, such as the ball
+//   instances, goes in the stream ring
+const size_t StreamBytesPerFrame = 64 * 1024;
+streamRing stream;
+
+// Multi-ball mode, toggled with the m key, adds balls that bounce around
+//   the court.  vaoBI reads each ball's ballInstance from where display()
+//   wrote it in the stream ring, sorted by level of detail.  Each level is
+//   an instanced draw starting at its first instance, and the render queue
+//   sends them all as one multi-draw.  Without base instances every ball
+//   is drawn at the ball in play's level by one instanced draw.
+const int MultiBallCount = 256;
+GLfloat ExtraBallScale = 0.4;
+bool isMultiBall = false;
+
+struct ballInstance{
+	Transform model;
+	GLubyte color[4];
+};
+
+struct extraBall{
+	vec3 position;
+	vec3 velocity;
+	GLubyte color[4];
+};
+
+std::vector<extraBall> extraBalls;
+vertexFormat instanceFormat;
+std::vector<GLuint> ballInstanceLods;	// of each ball, the ball in play first
+std::vector<GLuint> ballInstanceOrder;	// balls in the order they are written
+std::vector<GLuint> lodFirstInstance;	// of each level, then the ball count
+GLubyte BallColor[4] = { 0, 0, 255, 255 };	// material of the ball in play
+int FirstBallLevel = BakedSphereFirstLevel;
+GLenum BallIndexType;
+GLsizei BallIndexSize;
+
+// Ball level of detail.  Each frame the coarsest level whose triangle edges
+//   stay under MaxBallEdgePixels on screen is drawn.  A level is only left
+//   once the ideal level is LodHysteresis levels past it, so the ball
+//   doesn't flicker between two levels at the boundary.
+GLfloat MaxBallEdgePixels = 4.0;
+GLfloat LodHysteresis = 0.25;
+std::vector<sphereLOD> ballLods;
+size_t ballLod = 0;
+GLfloat pixelsPerUnit;	// screen size of one unit at a distance of one unit
 
 
 // Functional Prototypes
@@ -122,78 +254,88 @@ void init( );
 void printMat4( mat4 );
 void resetGame( );
 void display( SDL_Window* );
+color4 ballTint( );
+GLfloat eyeDistance( const Transform& );
+void printFrameStats( );
+void updateBallLod( );
+GLfloat idealBallLevel( GLfloat, GLfloat );
+size_t lodForLevel( GLfloat );
+void writeBallInstances( ballInstance* );
 void input( SDL_Window* );
 void updateCollision( );
 void updateScore( );
 void updateSpeed( );
 void updateBallPosition( bool );
+void updateExtraBalls( );
 void reshape( int, int );
+void updateCamera( );
 
 // -----------------------------------------------
 // -------------- F U N C T I O N S --------------
 // -----------------------------------------------
 
-//for angel sphere
-void triangle( const point4& a, const point4& b, const point4& c ){
-	vec3  normal = normalize( cross(b - a, c - b) );
-
-	normals[Index] = normal;  points[Index] = a;  Index++;
-	normals[Index] = normal;  points[Index] = b;  Index++;
-	normals[Index] = normal;  points[Index] = c;  Index++;
-}
-
-point4 unit( const point4& p ){
-	float len = p.x*p.x + p.y*p.y + p.z*p.z;
-
-	point4 t;
-	if ( len > DivideByZeroTolerance ) {
-		t = p / sqrt(len);
-		t.w = 1.0;
-	}
-
-	return t;
-}
-
-void divide_triangle( const point4& a, const point4& b, const point4& c, int count ){
-	if ( count > 0 ) {
-		point4 v1 = unit( a + b );
-		point4 v2 = unit( a + c );
-		point4 v3 = unit( b + c );
-		divide_triangle(  a, v1, v2, count - 1 );
-		divide_triangle(  c, v2, v3, count - 1 );
-		divide_triangle(  b, v3, v1, count - 1 );
-		divide_triangle( v1, v3, v2, count - 1 );
-	}
-	else {
-		triangle( a, b, c );
-	}
-}
-
-void tetrahedron( int count ){
-	point4 v[4] = {
-		vec4( 0.0, 0.0, 1.0, 1.0 ),
-		vec4( 0.0, 0.942809, -0.333333, 1.0 ),
-		vec4( -0.816497, -0.471405, -0.333333, 1.0 ),
-		vec4( 0.816497, -0.471405, -0.333333, 1.0 )
-	};
-
-	divide_triangle( v[0], v[1], v[2], count );
-	divide_triangle( v[3], v[2], v[1], count );
-	divide_triangle( v[0], v[3], v[1], count );
-	divide_triangle( v[0], v[2], v[3], count );
-}
-
 // OpenGL initialization
 void init(){
-	// Load shaders and use the resulting shader program
-	programP = InitShader( "vshaderP.glsl", "fshader_nolights_tex.glsl" );
-	programW = InitShader( "vshaderW.glsl", "fshader_nolights.glsl" );
-	programB = InitShader( "vshaderB.glsl", "fshader_lights.glsl" );
-
-	// Define data members
-	GLuint vbo;
-	// Subdivide a tetrahedron into a sphere
-	tetrahedron( NumTimesToSubdivide );
+	// Start building every shader program; the driver compiles them while
+	//   the meshes and texture are set up, up to the ball's vertex array.
+	//   Each is a variant of the shared sources, specialized by defines.
+	char ballDefines[128], lightDefines[64], drawDefines[64];
+	snprintf( drawDefines, sizeof(drawDefines), "MAX_DRAWS=%d%s", MaxDrawsPerRun,
+		hasDrawParameters() ? " HAS_DRAW_PARAMETERS" : "" );
+	snprintf( lightDefines, sizeof(lightDefines), "MAX_LIGHTS=%d MAX_LIGHT_TILES=%d",
+		MaxLights, MaxLightTiles );
+	snprintf( ballDefines, sizeof(ballDefines), "%s NORMAL_ENCODING=%d", lightDefines,
+		layoutNormals(BallLayout) );
+	std::string meshDefines = std::string(ballDefines) + " " + drawDefines;
+	std::string impostorDefines = std::string(lightDefines) + " " + drawDefines;
+	std::string instancedDefines = std::string(ballDefines) + " INSTANCED";
+
+	ProgramBatch shaderBatch;
+	shaderBatch.add( programS, "vshader_flat.glsl", "fshader_flat.glsl", drawDefines );
+	shaderBatch.add( programB, "vshaderB.glsl", "fshader_lights.glsl", meshDefines.c_str() );
+	shaderBatch.add( programI, "vshader_impostor.glsl", "fshader_impostor.glsl",
+		impostorDefines.c_str() );
+	shaderBatch.add( programBI, "vshaderB.glsl", "fshader_lights.glsl",
+		instancedDefines.c_str() );
+
+	// Use the sphere baked in at build time, already packed, or subdivide
+	//   a tetrahedron and pack it if a different level or layout was asked
+	//   for
+	sphereMesh ball;
+	sphereVertices packedBall;
+	std::vector<GLushort> shortIndices;
+	vertexFormat ballFormat = sphereFormat( BakedSphereLayout, BakedSphereNumPoints );
+	const GLvoid *ballData = BakedSphereVertices;
+	size_t ballDataSize = sizeof(BakedSphereVertices);
+	const GLvoid *ballIndices = BakedSphereIndices;
+	size_t indicesSize = sizeof(BakedSphereIndices);
+	ballLods.assign(BakedSphereLods, BakedSphereLods + BakedSphereNumLods);
+	BallIndexType = GL_UNSIGNED_SHORT;
+	BallIndexSize = sizeof(GLushort);
+
+	if (NumTimesToSubdivide != BakedSphereLevel || BallLayout != BakedSphereLayout){
+		FirstBallLevel = std::min(FirstBallLevel, NumTimesToSubdivide);
+		ball = tetrahedron( NumTimesToSubdivide, FirstBallLevel );
+		ballLods = ball.lods;
+		packedBall = packSphere( BallLayout, ball.points.data(), ball.normals.data(),
+			ball.points.size() );
+		ballFormat = packedBall.format;
+		ballData = packedBall.data.data();
+		ballDataSize = packedBall.data.size();
+
+		if (ball.points.size() <= 65536){
+			// Every vertex fits in 16 bits, which halves the index buffer
+			shortIndices.assign(ball.indices.begin(), ball.indices.end());
+			ballIndices = shortIndices.data();
+			indicesSize = shortIndices.size() * sizeof(GLushort);
+		}
+		else {
+			BallIndexType = GL_UNSIGNED_INT;
+			BallIndexSize = sizeof(GLuint);
+			ballIndices = ball.indices.data();
+			indicesSize = ball.indices.size() * sizeof(GLuint);
+		}
+	}
 
 	//texture mapping stuff
 	GLubyte textureData[]={
@@ -221,11 +363,34 @@ void init(){
 	// --------------------------------------------------------------------
 	// -------  V E R T E X   A R R A Y   O B J E C T   B A L L  -------
 	// --------------------------------------------------------------------
-	// Define offsets and sizes
-	posDataOffset = 0;
-	colorDataOffset = posDataOffset + sizeof(positionArray);
-	spherePosDataOffset = colorDataOffset + sizeof(colorArray);
-	normalsDataOffset = spherePosDataOffset + sizeof(points);
+	// Every mesh goes into the shared buffers: the paddle and wall, the
+	//   ball, the impostor's quad, and the draw indices that tell the draws
+	//   of a multi-draw apart without draw parameters
+	GLfloat drawIndices[MaxDrawsPerRun];
+	for (int i = 0; i < MaxDrawsPerRun; i++){
+		drawIndices[i] = i;
+	}
+	size_t staticDataOffset = meshes.addVertices( staticVertices, sizeof(staticVertices) );
+	size_t ballDataOffset = meshes.addVertices( ballData, ballDataSize );
+	size_t impostorDataOffset = meshes.addVertices( impostorCorners, sizeof(impostorCorners) );
+	size_t drawIndexOffset = meshes.addVertices( drawIndices, sizeof(drawIndices) );
+	ballIndexOffset = meshes.addIndices( ballIndices, indicesSize );
+	quadIndexOffset = meshes.addIndices( elemsArray, sizeof(elemsArray) );
+
+	vertexFormat drawIndexFormat;
+	vertexAttrib drawIndex = { "in_drawIndex", 1, GL_FLOAT, GL_FALSE, 0, sizeof(GLfloat), 1 };
+	drawIndexFormat.attribs.push_back( drawIndex );
+	drawIndexFormat.bytesPerVertex = sizeof(GLfloat);
+
+	shaderBatch.finish();
+
+	// With SHADER_DIR set, shaders edited there are rebuilt while the game
+	//   runs
+	Program* watchedPrograms[] = { &programS, &programB, &programI, &programBI };
+	for (int i = 0; i < 4; i++){
+		shaderWatcher.watch( *watchedPrograms[i] );
+	}
+	shaderWatcher.start();
 
 	// Use programB
 	glUseProgram( programB );
@@ -234,26 +399,15 @@ void init(){
 	glGenVertexArrays( 1,&vaoB );
 	glBindVertexArray( vaoB );
 
-	// Generate and bind new vertex buffer object and populate the buffer
-	glGenBuffers( 1,&vbo );
-	glBindBuffer( GL_ARRAY_BUFFER,vbo );
-	glBufferData( GL_ARRAY_BUFFER, sizeof(positionArray) + sizeof(colorArray) + sizeof(points) + 
-		sizeof(normals),NULL,GL_STATIC_DRAW );
-	glBufferSubData( GL_ARRAY_BUFFER,posDataOffset,sizeof(positionArray),positionArray );
-	glBufferSubData( GL_ARRAY_BUFFER,colorDataOffset,sizeof(colorArray),colorArray );
-	glBufferSubData( GL_ARRAY_BUFFER,spherePosDataOffset,sizeof(points), points );
-	glBufferSubData( GL_ARRAY_BUFFER,normalsDataOffset,sizeof(normals), normals );
+	// Create the vertex and element buffers from the meshes added above,
+	//   all still alive here, which leaves them bound, the element buffer
+	//   to vaoB
+	meshes.upload();
 
 	// set up vertex arrays
-	GLuint in_position = glGetAttribLocation( programB, "in_position" );
-	glEnableVertexAttribArray( in_position );
-	glVertexAttribPointer( in_position, 4, GL_FLOAT, GL_FALSE, 0,
-		BUFFER_OFFSET(spherePosDataOffset) );
-
-	GLuint in_normals = glGetAttribLocation( programB, "in_normals" ); 
-	glEnableVertexAttribArray( in_normals );
-	glVertexAttribPointer( in_normals, 3, GL_FLOAT, GL_FALSE, 0,
-		BUFFER_OFFSET(normalsDataOffset));
+	ballFormat.apply( programB, ballDataOffset );
+	drawIndexFormat.apply( programB, drawIndexOffset );
+	ballBytesPerVertex = ballFormat.bytesPerVertex;
 
 
 	// Light stuff for ball------------------------------------------
@@ -263,27 +417,34 @@ void init(){
 	color4 light_diffuseB( 1.0, 1.0, 1.0, 1.0 );
 	color4 light_specularB( 1.0, 1.0, 1.0, 1.0 );
 
-	color4 material_ambientB( 0.0, 0.0, 1.0, 1.0 );
-	color4 material_diffuseB( 0.0, 0.0, 1.0, 1.0 );
 	color4 material_specularB( 1.0, 1.0, 1.0, 1.0 );
 	float  material_shininessB = 5.0;
 	
-	color4 ambient_productB = light_ambientB * material_ambientB;
-	color4 diffuse_productB = light_diffuseB * material_diffuseB;
-	color4 specular_productB = light_specularB * material_specularB;
-
-	glUniform4fv( glGetUniformLocation(programB, "AmbientProduct"),
-		1, ambient_productB );
-	glUniform4fv( glGetUniformLocation(programB, "DiffuseProduct"),
-		1, diffuse_productB );
-	glUniform4fv( glGetUniformLocation(programB, "SpecularProduct"),
-		1, specular_productB );
-	
-	glUniform4fv( glGetUniformLocation(programB, "LightPosition"),
-		1, light_positionB );
-	
-	glUniform1f( glGetUniformLocation(programB, "Shininess"),
-		material_shininessB );
+	// The lights' products are taken with a white material, and the ball
+	//   programs multiply in the ball's color as a tint, BallColor from the
+	//   draw's data or each instance's own.
+	lightSource keyLight = { light_positionB, light_ambientB, light_diffuseB,
+		light_specularB, 0.0 };
+	lights.add( keyLight );
+	for (size_t i = 0; i < sizeof(ArenaLights) / sizeof(ArenaLights[0]); i++){
+		lights.add( ArenaLights[i] );
+	}
+	lights.setMaterial( color4( 1.0, 1.0, 1.0, 1.0 ), color4( 1.0, 1.0, 1.0, 1.0 ),
+		material_specularB );
+	lights.create( LightsBinding );
+
+	const Program* ballPrograms[] = { &programB, &programI, &programBI };
+	for (int i = 0; i < 3; i++){
+		const Program& program = *ballPrograms[i];
+		glUseProgram( program );
+
+		program.uniform<GLfloat>("Shininess").set( material_shininessB );
+
+		GLuint lightsIndex = program.uniformBlock( "Lights" );
+		if (lightsIndex != GL_INVALID_INDEX){
+			glUniformBlockBinding( program, lightsIndex, LightsBinding );
+		}
+	}
 
 	// Release bind to vaoB and programB
 	glBindVertexArray( 0 );
@@ -291,100 +452,139 @@ void init(){
 	// ------------------------------------------------------------------------
 
 	// ------------------------------------------------------------------------
-	// -------  V E R T E X   A R R A Y   O B J E C T   P A D D L E  -------
+	// -------  V E R T E X   A R R A Y   O B J E C T   I M P O S T O R  -------
 	// ------------------------------------------------------------------------
-	// Define new offsets
-	//posDataOffset += sizeof(GLfloat) * 3 * NumVerticies;
-	//colorDataOffset += sizeof(GLfloat) * 4 * NumVerticies;
-	//sphere position data offset (points) stays constant
-	//normals data offset (normals) stays constant
+	// Use programI
+	glUseProgram( programI );
 
-	// Use programP
-	glUseProgram( programP );
+	// Generate new vertex array object, using the same vertex buffer as vaoB
+	glGenVertexArrays( 1,&vaoI );
+	glBindVertexArray( vaoI );
 
-	// Generate and bind new vertex array object
-	glGenVertexArrays( 1,&vaoP );
-	glBindVertexArray( vaoP );
-
-	// Bind position attribute of vbo
-	in_position = glGetAttribLocation( programP, "in_position" );
-	glVertexAttribPointer( in_position,3,GL_FLOAT,GL_FALSE,0,BUFFER_OFFSET(posDataOffset) );
-	glEnableVertexAttribArray( in_position );
-
-	// Bind color attribute of vbo
-	GLuint in_color = glGetAttribLocation( programP, "in_color" );
-	glVertexAttribPointer( in_color,4,GL_FLOAT,GL_FALSE,0,BUFFER_OFFSET(colorDataOffset) );
-	glEnableVertexAttribArray( in_color );
-
-	// Generate and bind element buffer object
-	glGenBuffers( 1,&eboP );
-	glBindBuffer( GL_ELEMENT_ARRAY_BUFFER,eboP );
-	glBufferData( GL_ELEMENT_ARRAY_BUFFER,sizeof(elemsArray),elemsArray,GL_STATIC_DRAW );
-
-	glGenBuffers(1, &vbo_cube_texcoords);
-	glBindBuffer(GL_ARRAY_BUFFER, vbo_cube_texcoords);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(cube_texcoords), cube_texcoords, GL_STATIC_DRAW);
-
-	// Bind texture positions
-	attribute_texcoord = glGetAttribLocation(programP, "texcoord");
-	glEnableVertexAttribArray(attribute_texcoord);
-	glVertexAttribPointer(attribute_texcoord, 2, GL_FLOAT, GL_FALSE, 0, 0);
-
-	// Release bind to vaoP and programP and the paddle texture
-	glBindTexture( 0, 0 );
-	glBindVertexArray( 0 );
-	glUseProgram( 0 );
-
-	// --------------------------------------------------------------------
-
-	// --------------------------------------------------------------------
-	// -------  V E R T E X   A R R A Y   O B J E C T   W A L L  -------
-	// --------------------------------------------------------------------
-	// Define new offsets
-	posDataOffset += sizeof(GLfloat) * 3 * NumVerticies;
-	colorDataOffset += sizeof(GLfloat) * 4 * NumVerticies;
-	//sphere position data offset (points) stays constant
-	//normals data offset (normals) stays constant
-
-	// Use programW
-	glUseProgram( programW );
+	GLint in_corner = programI.attrib( "in_corner" );
+	glEnableVertexAttribArray( in_corner );
+	glVertexAttribPointer( in_corner, 2, GL_FLOAT, GL_FALSE, 0,
+		BUFFER_OFFSET(impostorDataOffset) );
+	drawIndexFormat.apply( programI, drawIndexOffset );
 
-	// Generate new vertex array object
-	glGenVertexArrays( 1,&vaoW );
-	glBindVertexArray( vaoW );
+	// The ball mesh is a unit sphere, which the impostor matches
+	programI.uniform<GLfloat>("Radius").set( 1.0 );
 
-	// Bind vertex buffer object
-	// --Use same vbo as vaoP (no new buffer has been bound)
+	// Release bind to vaoI and programI
+	glBindVertexArray( 0 );
+	glUseProgram( 0 );
+	// ------------------------------------------------------------------------
 
-	// Bind attributes to vertex array
-	in_position = glGetAttribLocation( programW, "in_position" );
-	glVertexAttribPointer(in_position,3,GL_FLOAT,GL_FALSE,0,BUFFER_OFFSET(posDataOffset));
-	glEnableVertexAttribArray( in_position );
+	// ------------------------------------------------------------------------
+	// -------  V E R T E X   A R R A Y   O B J E C T   B A L L S  -------
+	// ------------------------------------------------------------------------
+	// Use programBI
+	glUseProgram( programBI );
+
+	// Generate new vertex array object, with the ball's vertices and
+	//   indices from vaoB and one ballInstance per instance
+	glGenVertexArrays( 1,&vaoBI );
+	glBindVertexArray( vaoBI );
+
+	glBindBuffer( GL_ARRAY_BUFFER,meshes.vertices() );
+	ballFormat.apply( programBI, ballDataOffset );
+	glBindBuffer( GL_ELEMENT_ARRAY_BUFFER,meshes.indices() );
+
+	// The instances are written into the stream ring every frame in
+	//   multi-ball mode, and display() points vaoBI at them
+	stream.create( StreamBytesPerFrame );
+
+	GLsizei instanceStride = sizeof(ballInstance);
+	const char* modelRows[] = { "in_model0", "in_model1", "in_model2" };
+	for (int row = 0; row < 3; row++){
+		vertexAttrib a = { modelRows[row], 4, GL_FLOAT, GL_FALSE,
+			offsetof(ballInstance, model) + row * sizeof(vec4), instanceStride, 1 };
+		instanceFormat.attribs.push_back( a );
+	}
+	vertexAttrib tint = { "in_tint", 4, GL_UNSIGNED_BYTE, GL_TRUE,
+		offsetof(ballInstance, color), instanceStride, 1 };
+	instanceFormat.attribs.push_back( tint );
+	instanceFormat.bytesPerVertex = sizeof(ballInstance);
+	instanceFormat.apply( programBI, 0 );
+
+	// Scatter the extra balls through the court, each in its own color
+	extraBalls.resize( MultiBallCount - 1 );
+	for (size_t i = 0; i < extraBalls.size(); i++){
+		extraBall& b = extraBalls[i];
+		b.position = vec3( LeftWallX + (RightWallX - LeftWallX) * rand() / RAND_MAX,
+			FloorY + (CeilingY - FloorY) * rand() / RAND_MAX,
+			WallPosInitial.z + (PaddlePosInitial.z - WallPosInitial.z) * rand() / RAND_MAX );
+		b.velocity = vec3( 0.4 * rand() / RAND_MAX - 0.2, 0.4 * rand() / RAND_MAX - 0.2,
+			0.4 * rand() / RAND_MAX - 0.2 );
+		for (int c = 0; c < 3; c++){
+			b.color[c] = 64 + rand() % 192;
+		}
+		b.color[3] = 255;
+	}
 
-	in_color = glGetAttribLocation( programW, "in_color" );
-	glVertexAttribPointer(in_color,4,GL_FLOAT,GL_FALSE,0,BUFFER_OFFSET(colorDataOffset));
-	glEnableVertexAttribArray( in_color );
+	// Release bind to vaoBI and programBI
+	glBindVertexArray( 0 );
+	glUseProgram( 0 );
+	// ------------------------------------------------------------------------
 
-	// Generate and bind element buffer object
-	glGenBuffers( 1,&eboW );
-	glBindBuffer( GL_ELEMENT_ARRAY_BUFFER,eboW );
-	glBufferData( GL_ELEMENT_ARRAY_BUFFER,sizeof(elemsArray),elemsArray,GL_STATIC_DRAW );
+	// ------------------------------------------------------------------------
+	// -------  V E R T E X   A R R A Y   O B J E C T   S T A T I C  -------
+	// ------------------------------------------------------------------------
+	// Use programS
+	glUseProgram( programS );
 
-	// Release bind to vaoW and programW
+	// Generate and bind new vertex array object
+	glGenVertexArrays( 1,&vaoS );
+	glBindVertexArray( vaoS );
+
+	// Bind position, color and texture position attributes of the paddle
+	//   and wall, which draw from their own quads in the shared element
+	//   buffer
+	glBindBuffer( GL_ARRAY_BUFFER,meshes.vertices() );
+	staticFormat.apply( programS, staticDataOffset );
+	drawIndexFormat.apply( programS, drawIndexOffset );
+	glBindBuffer( GL_ELEMENT_ARRAY_BUFFER,meshes.indices() );
+
+	// The paddle texture is always read from unit 0
+	programS.uniform<GLint>("texture").set( 0 );
+
+	// Release bind to vaoS and programS and the paddle texture
+	glBindTexture( GL_TEXTURE_2D, 0 );
 	glBindVertexArray( 0 );
 	glUseProgram( 0 );
 	// --------------------------------------------------------------------
 
 
-	// Retrieve transformation uniform variable locations
-	mMatrix = glGetUniformLocation( programP, "modelMatrix" );
-	vMatrix = glGetUniformLocation( programP, "viewMatrix" );
-	pMatrix = glGetUniformLocation( programP, "projectionMatrix" );
+	// Every program reads the camera from the one uniform buffer, and its
+	//   draws' data from the range the render queue binds
+	const Program* programs[] = { &programS, &programB, &programI, &programBI };
+	for (int i = 0; i < 4; i++){
+		GLuint cameraIndex = programs[i]->uniformBlock( "Camera" );
+		if (cameraIndex != GL_INVALID_INDEX){
+			glUniformBlockBinding( *programs[i], cameraIndex, CameraBinding );
+		}
+		GLuint drawsIndex = programs[i]->uniformBlock( "Draws" );
+		if (drawsIndex != GL_INVALID_INDEX){
+			glUniformBlockBinding( *programs[i], drawsIndex, DrawsBinding );
+		}
+	}
+	queue.setDrawsBinding( DrawsBinding );
+	glGenBuffers( 1,&camera.ubo );
+	glBindBuffer( GL_UNIFORM_BUFFER,camera.ubo );
+	glBufferData( GL_UNIFORM_BUFFER,sizeof(cameraBlock),NULL,GL_DYNAMIC_DRAW );
+	glBindBufferBase( GL_UNIFORM_BUFFER,CameraBinding,camera.ubo );
+
+	// The camera never moves, so the view is only built once
+	camera.block.view = LookAt( eye, at, up );
 
 	// Initialize model matrices to their correct positions
-	modelP = identity() * Translate(PaddlePosInitial);
-	modelW = identity() * Translate(WallPosInitial);
-	modelB = identity() * Translate(BallPosInitial);
+	modelP = Transform(PaddlePosInitial);
+	modelW = Transform(WallPosInitial);
+	modelB = Transform(BallPosInitial);
+	derivedB.isDirty = true;
+
+	// The projection depends on the paddle and wall depths
+	reshape( WindowWidth,WindowHeight );
 
 	// Initialize ball velocity
 	ballVel.x = VelInitial.x;
@@ -395,6 +595,9 @@ void init(){
 	glDisable( GL_CULL_FACE );
 
 	glClearColor( 1.0, 1.0, 1.0, 1.0 ); // black background
+
+	// Everything above was bound directly, so the cache starts over
+	gl.invalidate();
 }
 
 //----------------------------------------------------------------------------
@@ -419,9 +622,9 @@ void resetGame(){
 	score = 0;
 
 	// Reset vao models
-	modelP = identity() * Translate(PaddlePosInitial);
-	modelW = identity() * Translate(WallPosInitial);
-	modelB = identity() * Translate(BallPosInitial);
+	modelP = Transform(PaddlePosInitial);
+	modelW = Transform(WallPosInitial);
+	modelB = Transform(BallPosInitial);
 	ballVel = VelInitial;
 	updateBallPosition(true);
 }
@@ -431,54 +634,115 @@ void resetGame(){
 void display( SDL_Window* screen ){
 	glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
 
-	// Define view
-	mat4 view = LookAt( eye, at, up );
+	stream.beginFrame();
+	updateCamera();
+	lights.update( camera.block.view, camera.block.projection, WindowWidth, WindowHeight );
 
-	// Draw elements of vaoB
-	glUseProgram( programB );
-	glBindVertexArray( vaoB );
-	glUniformMatrix4fv( mMatrix, 1, GL_TRUE, modelB );
-	glUniformMatrix4fv( vMatrix, 1, GL_TRUE, view );
-	glDrawArrays(GL_TRIANGLES, 0, NumVertices);
-	glBindVertexArray( 0 );
-	glUseProgram( 0 );
+	if (derivedB.isDirty){
+		derivedB.modelView = camera.block.view * mat4(modelB);
+		derivedB.normal = Normal(derivedB.modelView);
+		derivedB.isDirty = false;
+	}
 
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-	glDepthMask(0);
+	// Queue every object; the queue decides the order they are drawn in
+	GLfloat ballDistance = -derivedB.modelView[2][3];
+	size_t instancesOffset;
+	ballInstance* instances = NULL;
+	if (isMultiBall){
+		instances = static_cast<ballInstance*>( stream.allocate(
+			MultiBallCount * sizeof(ballInstance), alignof(ballInstance),
+			instancesOffset ) );
+	}
+	if (instances != NULL){
+		// Every ball, one instanced draw per level of detail in use
+		writeBallInstances( instances );
+
+		gl.bindVertexArray( vaoBI );
+		glBindBuffer( GL_ARRAY_BUFFER,stream.name() );
+		instanceFormat.rebase( instancesOffset );
+
+		for (size_t i = 0; i < ballLods.size(); i++){
+			GLuint first = lodFirstInstance[i];
+			GLsizei count = lodFirstInstance[i + 1] - first;
+			if (count == 0){
+				continue;
+			}
+			const sphereLOD& lod = ballLods[i];
+			drawItem balls = { programBI, vaoBI, 0, GL_TRIANGLES, GLsizei(lod.count),
+				BallIndexType, ballIndexOffset + size_t(lod.first) * BallIndexSize,
+				NULL, count, first };
+			queue.submit( balls, OpaquePass, ballDistance );
+		}
+	}
+	else if (drawBallImpostor){
+		// Draw the ball as one quad, ray-cast by programI
+		drawItem ball = { programI, vaoI, 0, GL_TRIANGLE_FAN, 4, 0, 0, NULL, 0, 0 };
+		queue.submit( ball, OpaquePass, ballDistance,
+			drawData(derivedB.modelView, derivedB.normal, ballTint()) );
+	}
+	else {
+		updateBallLod();
+		const sphereLOD& lod = ballLods[ballLod];
+		drawItem ball = { programB, vaoB, 0, GL_TRIANGLES, GLsizei(lod.count),
+			BallIndexType, ballIndexOffset + size_t(lod.first) * BallIndexSize,
+			NULL, 0, 0 };
+		queue.submit( ball, OpaquePass, ballDistance,
+			drawData(derivedB.modelView, derivedB.normal, ballTint()) );
+	}
 
-	// Draw elements of vaoW
-	glUseProgram( programW );
-	glBindVertexArray( vaoW );
-	glUniformMatrix4fv( mMatrix, 1, GL_TRUE, modelW );
-	glUniformMatrix4fv( vMatrix, 1, GL_TRUE, view );
-	glDrawElements( GL_TRIANGLE_FAN,sizeof(elemsArray),GL_UNSIGNED_BYTE,0 );
-	glBindVertexArray( 0 );
-	glUseProgram( 0 );
+	// The wall and paddle share their state, so they go out as one
+	//   multi-draw, the paddle textured and the wall colored per vertex
+	color4 white( 1.0, 1.0, 1.0, 1.0 );
+	drawItem wall = { programS, vaoS, texture_id, GL_TRIANGLE_FAN, GLsizei(NumVerticies),
+		GL_UNSIGNED_BYTE, quadIndexOffset + NumVerticies, NULL, 0, 0 };
+	queue.submit( wall, TransparentPass, eyeDistance(modelW),
+		drawData(camera.block.view * mat4(modelW), white, 0.0) );
+
+	drawItem paddle = { programS, vaoS, texture_id, GL_TRIANGLE_FAN, GLsizei(NumVerticies),
+		GL_UNSIGNED_BYTE, quadIndexOffset, NULL, 0, 0 };
+	queue.submit( paddle, TransparentPass, eyeDistance(modelP),
+		drawData(camera.block.view * mat4(modelP), white, 1.0) );
+
+	queue.flush( gl, stream );
+	drawCalls += queue.drawCalls();
+	stream.endFrame();
+
+	// glClear() only clears the depth buffer while it is writable.  The
+	//   swap flushes the frame, and programs and arrays stay bound.
+	gl.setBlend( false );
+	gl.setDepthMask( true );
+	SDL_GL_SwapWindow(screen);
+	gl.endFrame();
+}
 
-	// Draw elements of vaoP
-	glUseProgram( programP );
-	glBindVertexArray( vaoP );
-	glUniformMatrix4fv( mMatrix, 1, GL_TRUE, modelP );
-	glUniformMatrix4fv( vMatrix, 1, GL_TRUE, view );
+//----------------------------------------------------------------------------
 
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, texture_id);
-	uniform_mytexture = glGetUniformLocation(programP, "texture");
-	glUniform1i(uniform_mytexture, 0);
+// Material of the ball in play, which its shaders multiply the lights by
+color4 ballTint( ){
+	return color4( BallColor[0], BallColor[1], BallColor[2], BallColor[3] ) / 255.0;
+}
 
-	glDrawElements( GL_TRIANGLE_FAN,sizeof(elemsArray),GL_UNSIGNED_BYTE,0 );
-	glBindVertexArray( 0 );
-	glUseProgram( 0 );
+//----------------------------------------------------------------------------
 
-	glDisable(GL_BLEND);
-	glDepthMask(1);
+// Distance in front of the eye of an object's origin
+GLfloat eyeDistance( const Transform& model ){
+	return -(camera.block.view * vec4(model.translation(), 1.0)).z;
+}
 
-	// Release binds and swap buffers
-	glBindVertexArray( 0 );
-	glUseProgram( 0 );
-	glFlush();
-	SDL_GL_SwapWindow(screen);
+//----------------------------------------------------------------------------
+
+// Reports the ball's vertex size, the average time display() took and how
+//   many GL calls the state cache skipped
+void printFrameStats( ){
+	if (framesDrawn == 0){
+		return;
+	}
+	printf("ball layout %s: %zu bytes/vertex, %.3f ms/frame in display()\n",
+		SphereLayoutNames[BallLayout], ballBytesPerVertex,
+		1000.0 * displaySeconds / framesDrawn);
+	printf("%.1f redundant GL calls/frame suppressed\n",
+		double(gl.totalSuppressed) / gl.frames);
+	printf("%.1f draw calls/frame\n", double(drawCalls) / framesDrawn);
 }
 
 //----------------------------------------------------------------------------
@@ -492,6 +756,11 @@ void input(SDL_Window* screen){
 		switch (event.type){
 			case SDL_QUIT:
 			exit(EXIT_SUCCESS);
+			case SDL_WINDOWEVENT:
+			if (event.window.event == SDL_WINDOWEVENT_SIZE_CHANGED){
+				reshape(event.window.data1, event.window.data2);
+			}
+			break;
 			case SDL_KEYDOWN:
 			switch(event.key.keysym.sym){
 				case SDLK_ESCAPE:
@@ -499,27 +768,33 @@ void input(SDL_Window* screen){
 				exit(EXIT_SUCCESS);
 			case SDLK_w: case SDLK_UP:	// move paddle up
 			if (modelP[1][3] < CeilingY - FloatImprecisionFactor) {
-				modelP = modelP * Translate(0.0,1.0,0.0);
+				modelP.translate(0.0,1.0,0.0);
 			}
 			break;
 			case SDLK_s: case SDLK_DOWN:	// move paddle down;
 			if (modelP[1][3] > FloorY + FloatImprecisionFactor) {
-				modelP = modelP * Translate(0.0,-1.0,0.0);
+				modelP.translate(0.0,-1.0,0.0);
 			}
 			break;
 			case SDLK_d: case SDLK_RIGHT:	// move paddle right;
 			if (modelP[0][3] < RightWallX - FloatImprecisionFactor) {
-				modelP = modelP * Translate(1.0,0.0,0.0);
+				modelP.translate(1.0,0.0,0.0);
 			}
 			break;
 			case SDLK_a: case SDLK_LEFT:	// move paddle left;
 			if (modelP[0][3] > LeftWallX + FloatImprecisionFactor) {
-				modelP = modelP * Translate(-1.0,0.0,0.0);
+				modelP.translate(-1.0,0.0,0.0);
 			}
 			break;
 			case SDLK_r://new game
 			resetGame();
 			break;
+			case SDLK_m://switch multi-ball mode
+			isMultiBall = !isMultiBall;
+			break;
+			case SDLK_i://switch between the ball mesh and impostor
+			drawBallImpostor = !drawBallImpostor;
+			break;
 		}
 		case SDL_MOUSEMOTION:
 		float MouseMotionFactor = 26.0;
@@ -557,7 +832,7 @@ prevMouseX = mouseX;
 prevMouseY = mouseY;
 
 			// Move the paddle accordingly
-modelP = modelP * Translate(translationVec3);
+modelP.translate(translationVec3);
 
 break;
 }
@@ -694,28 +969,166 @@ void updateBallPosition(bool forceReset){
 	}
 
 	// Translate ball based on ball's velocity
-	modelB = modelB * Translate(ballVel.x, ballVel.y, ballVel.z);
+	modelB.translate(ballVel);
+	derivedB.isDirty = true;
 }
 
 //----------------------------------------------------------------------------
 
+// Moves the multi-ball mode's extra balls, bouncing them off the sides of
+//   the court, the wall and the paddle's plane
+void updateExtraBalls( ){
+	GLfloat r = ExtraBallScale;
+	vec3 low( LeftWallX + r, FloorY + r, WallPosInitial.z + r );
+	vec3 high( RightWallX - r, CeilingY - r, PaddlePosInitial.z - r );
+
+	for (size_t i = 0; i < extraBalls.size(); i++){
+		extraBall& b = extraBalls[i];
+		b.position += b.velocity;
+		for (int axis = 0; axis < 3; axis++){
+			if ((b.position[axis] < low[axis] && b.velocity[axis] < 0.0) ||
+			    (b.position[axis] > high[axis] && b.velocity[axis] > 0.0)){
+				b.velocity[axis] = -b.velocity[axis];
+			}
+		}
+	}
+}
+
+//----------------------------------------------------------------------------
+
+// Picks the level of detail of the ball from its projected radius
+void updateBallLod( ){
+	// The mesh is a unit sphere and modelB doesn't scale it
+	GLfloat distance = -derivedB.modelView[2][3];
+	if (distance <= 1.0){
+		ballLod = ballLods.size() - 1;
+		return;
+	}
+	GLfloat ideal = idealBallLevel( 1.0, distance );
+
+	// Level L is good enough for an ideal level between L - 1 and L
+	while (ballLod + 1 < ballLods.size() && ideal > ballLods[ballLod].level + LodHysteresis){
+		ballLod++;
+	}
+	while (ballLod > 0 && ideal < ballLods[ballLod].level - 1 - LodHysteresis){
+		ballLod--;
+	}
+}
+
+//----------------------------------------------------------------------------
+
+// Returns the level of subdivision, not necessarily whole, at which a ball
+//   of radius at distance from the eye has triangle edges MaxBallEdgePixels
+//   long on screen
+GLfloat idealBallLevel( GLfloat radius, GLfloat distance ){
+	GLfloat radiusPixels = pixelsPerUnit * radius / distance;
+
+	// A tetrahedron inscribed in the unit sphere has edges 2*sqrt(2/3) long,
+	//   and every level of subdivision roughly halves them
+	GLfloat edgePixels = radiusPixels * 2.0 * sqrt(2.0 / 3.0) / MaxBallEdgePixels;
+	return edgePixels > 0.0 ? log2(edgePixels) : 0.0;
+}
+
+//----------------------------------------------------------------------------
+
+// Returns the coarsest level of detail good enough for the ideal level
+size_t lodForLevel( GLfloat ideal ){
+	size_t lod = 0;
+	while (lod + 1 < ballLods.size() && ideal > ballLods[lod].level){
+		lod++;
+	}
+	return lod;
+}
+
+//----------------------------------------------------------------------------
+
+// Writes every ball's instance, grouped by level of detail, and sets
+//   lodFirstInstance.  The ball in play keeps its own level and the extra
+//   balls take the level their distance calls for, without hysteresis.
+void writeBallInstances( ballInstance* instances ){
+	bool isPerBallLod = GLEW_VERSION_4_2 || GLEW_ARB_base_instance;
+	updateBallLod();
+
+	ballInstanceLods.resize( MultiBallCount );
+	ballInstanceOrder.resize( MultiBallCount );
+	lodFirstInstance.assign( ballLods.size() + 1, 0 );
+
+	ballInstanceLods[0] = ballLod;
+	for (size_t i = 0; i < extraBalls.size(); i++){
+		GLuint lod = ballLod;
+		if (isPerBallLod){
+			GLfloat distance = -(camera.block.view * vec4(extraBalls[i].position, 1.0)).z;
+			lod = distance <= ExtraBallScale ? ballLods.size() - 1 :
+				lodForLevel( idealBallLevel(ExtraBallScale, distance) );
+		}
+		ballInstanceLods[i + 1] = lod;
+	}
+
+	// Counting sort of the balls by level, leaving lodFirstInstance[i] the
+	//   first instance of level i
+	for (int b = 0; b < MultiBallCount; b++){
+		lodFirstInstance[ballInstanceLods[b] + 1]++;
+	}
+	for (size_t i = 1; i < lodFirstInstance.size(); i++){
+		lodFirstInstance[i] += lodFirstInstance[i - 1];
+	}
+	for (int b = 0; b < MultiBallCount; b++){
+		ballInstanceOrder[lodFirstInstance[ballInstanceLods[b]]++] = b;
+	}
+	for (size_t i = lodFirstInstance.size() - 1; i > 0; i--){
+		lodFirstInstance[i] = lodFirstInstance[i - 1];
+	}
+	lodFirstInstance[0] = 0;
+
+	// The instances are written in order and never read back, as they are
+	//   in GPU visible memory
+	for (int k = 0; k < MultiBallCount; k++){
+		GLuint b = ballInstanceOrder[k];
+		ballInstance& instance = instances[k];
+		if (b == 0){
+			instance.model = modelB;
+			std::copy( BallColor, BallColor + 4, instance.color );
+		}
+		else {
+			const extraBall& extra = extraBalls[b - 1];
+			instance.model = Transform( Translate(extra.position) *
+				Scale(ExtraBallScale, ExtraBallScale, ExtraBallScale) );
+			std::copy( extra.color, extra.color + 4, instance.color );
+		}
+	}
+}
+
+//----------------------------------------------------------------------------
+
+// Called when the window changes size
 void reshape( int width, int height ){
+	WindowWidth = width;
+	WindowHeight = height;
 	glViewport( 0, 0, width, height );
 
 	GLfloat zNearPersp = abs(modelP[2][3])-1.0, zFarPersp = modelW[2][3]-1.0;
-	GLfloat FovY = 150.0;
 
 	GLfloat aspect = GLfloat(width)/height;
+	pixelsPerUnit = 0.5 * height / tan(DegreesToRadians * FovY / 2.0);
 
-	mat4 projection = Perspective( FovY, aspect, zNearPersp, zFarPersp );
+	camera.block.projection = Perspective( FovY, aspect, zNearPersp, zFarPersp );
+	queue.setMaxDistance( abs(zFarPersp) );
+	camera.isDirty = true;
+	lights.invalidate();
+}
 
-	// Bind new projection to each program
-	glUseProgram( programP );
-	glUniformMatrix4fv( pMatrix, 1, GL_TRUE, projection );
+//----------------------------------------------------------------------------
 
-	glUseProgram( programB );
-	glUniformMatrix4fv( pMatrix, 1, GL_TRUE, projection );
-	glUseProgram( 0 );
+// Writes the camera uniform buffer if the view or projection has changed
+void updateCamera( ){
+	if (!camera.isDirty){
+		return;
+	}
+	camera.block.viewProjection = camera.block.projection * camera.block.view;
+	camera.isDirty = false;
+
+	glBindBuffer( GL_UNIFORM_BUFFER,camera.ubo );
+	glBufferSubData( GL_UNIFORM_BUFFER,0,sizeof(cameraBlock),&camera.block );
 }
 
 //----------------------------------------------------------------------------
@@ -742,7 +1155,7 @@ int main( int argc, char **argv )
 		SDL_WINDOWPOS_UNDEFINED,	//initial y position
 		WindowWidth,				//width, in pixels
 		WindowHeight,				//height, in pixels
-		SDL_WINDOW_OPENGL			//flags to be had
+		SDL_WINDOW_OPENGL | SDL_WINDOW_RESIZABLE	//flags to be had
 		);
 
 	//check window creation
@@ -753,6 +1166,26 @@ int main( int argc, char **argv )
 	//creates opengl context associated with the window
 	SDL_GLContext glcontext=SDL_GL_CreateContext(window);
 
+	if (argc > 1){
+		NumTimesToSubdivide = atoi(argv[1]);
+		if (NumTimesToSubdivide < 0){
+			fprintf(stderr, "Ball level %s must be 0 or more\n", argv[1]);
+			exit(EXIT_FAILURE);
+		}
+	}
+	if (argc > 2){
+		int layout = 0;
+		while (layout < NumSphereLayouts && strcmp(argv[2], SphereLayoutNames[layout]) != 0){
+			layout++;
+		}
+		if (layout == NumSphereLayouts){
+			fprintf(stderr, "Unknown ball layout %s\n", argv[2]);
+			exit(EXIT_FAILURE);
+		}
+		BallLayout = sphereLayout(layout);
+	}
+	atexit(printFrameStats);
+
 	//initializes glew
 	glewExperimental=GL_TRUE;
 	if(glewInit()){
@@ -777,8 +1210,21 @@ int main( int argc, char **argv )
 		updateScore();
 		updateSpeed();
 		updateBallPosition(false);
-		reshape(WindowWidth,WindowHeight);
+		if (isMultiBall){
+			updateExtraBalls();
+		}
+
+		// Swap in the shader programs rebuilt since the last frame, which
+		//   keep their uniform values and block bindings; per-object values
+		//   are in the Draws block, so only the state cache starts over
+		if (shaderWatcher.update()){
+			gl.invalidate();
+		}
+		std::chrono::steady_clock::time_point displayBegin = std::chrono::steady_clock::now();
 		display(window);
+		displaySeconds += std::chrono::duration<double>(
+			std::chrono::steady_clock::now() - displayBegin).count();
+		framesDrawn++;
 
 		// Frame rate management
 		ticksEnd = SDL_GetTicks();
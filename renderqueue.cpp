@@ -0,0 +1,296 @@
+// sort-key ordered queue of draw calls
+
+#include "renderqueue.h"
+#include "vertexformat.h"
+
+// Bits of each field of a sort key
+const int PassBits = 2;
+const int NameBits = 8;
+const int DepthBits = 24;
+const int UnusedBits = 64 - PassBits - 3*NameBits - DepthBits;
+
+// The keys are sorted one byte at a time, least significant first
+const int RadixBits = 8;
+const int RadixSize = 1 << RadixBits;
+
+//----------------------------------------------------------------------------
+
+drawData::drawData( const mat4& modelView, const mat3& normal, const vec4& tint )
+	: modelView(modelView), tint(tint), textured(0.0){
+	for (int i = 0; i < 3; i++){
+		normalMatrix[i] = vec4(normal[i], 0.0);
+	}
+	unused[0] = unused[1] = unused[2] = 0.0;
+}
+
+drawData::drawData( const mat4& modelView, const vec4& tint, GLfloat textured )
+	: modelView(modelView), tint(tint), textured(textured){
+	unused[0] = unused[1] = unused[2] = 0.0;
+}
+
+//----------------------------------------------------------------------------
+
+void renderQueue::submit( const drawItem& item, renderPass pass, GLfloat distance,
+		const drawData& data ){
+	GLfloat scaled = distance / maxDistance;
+	scaled = scaled < 0.0 ? 0.0 : (scaled > 1.0 ? 1.0 : scaled);
+
+	const uint64_t NameMask = (uint64_t(1) << NameBits) - 1;
+	const uint64_t MaxDepth = (uint64_t(1) << DepthBits) - 1;
+	uint64_t depth = uint64_t(scaled * MaxDepth);
+	uint64_t state = (uint64_t(item.program & NameMask) << 2*NameBits) |
+		(uint64_t(item.vertexArray & NameMask) << NameBits) |
+		uint64_t(item.texture & NameMask);
+
+	uint64_t key = uint64_t(pass) << (64 - PassBits);
+	if (pass == OpaquePass){
+		key |= ((state << DepthBits) | depth) << UnusedBits;
+	}
+	else {
+		key |= (((MaxDepth - depth) << 3*NameBits) | state) << UnusedBits;
+	}
+
+	sortEntry entry = { key, uint32_t(items.size()) };
+	entries.push_back(entry);
+	items.push_back(item);
+	itemData.push_back(data);
+}
+
+//----------------------------------------------------------------------------
+
+// LSD radix sort of the entries by key.  Bytes that every key shares are
+//   skipped, which with a handful of objects is most of them.
+void renderQueue::sort( ){
+	size_t n = entries.size();
+	scratch.resize(n);
+
+	uint64_t differing = 0;
+	for (size_t i = 1; i < n; i++){
+		differing |= entries[i].key ^ entries[0].key;
+	}
+
+	for (int shift = 0; shift < 64; shift += RadixBits){
+		if (((differing >> shift) & (RadixSize - 1)) == 0){
+			continue;
+		}
+
+		size_t offsets[RadixSize] = { 0 };
+		for (size_t i = 0; i < n; i++){
+			offsets[(entries[i].key >> shift) & (RadixSize - 1)]++;
+		}
+		size_t total = 0;
+		for (int d = 0; d < RadixSize; d++){
+			size_t count = offsets[d];
+			offsets[d] = total;
+			total += count;
+		}
+		for (size_t i = 0; i < n; i++){
+			scratch[offsets[(entries[i].key >> shift) & (RadixSize - 1)]++] = entries[i];
+		}
+		entries.swap(scratch);
+	}
+}
+
+//----------------------------------------------------------------------------
+
+const drawItem& renderQueue::sortOnly( ){
+	sort();
+	return items[entries[0].item];
+}
+
+//----------------------------------------------------------------------------
+
+// Layout glMultiDrawElementsIndirect() reads each draw from
+struct drawElementsCommand{
+	GLuint count;
+	GLuint instanceCount;
+	GLuint firstIndex;
+	GLint  baseVertex;
+	GLuint baseInstance;
+};
+
+// Marks a run that is drawn without indirect commands, or without data
+const size_t NoCommands = ~size_t(0);
+const size_t NoData = ~size_t(0);
+
+// Marks a single draw whose data is uploaded to the fallback buffer
+const size_t FallbackData = ~size_t(1);
+
+//----------------------------------------------------------------------------
+
+// Returns the end of the run of draws that can go out with entry begin.
+//   Draws that aren't instanced only go together if each can be told
+//   apart by gl_DrawIDARB or by its baseInstance.
+size_t renderQueue::runEnd( size_t begin ) const{
+	const drawItem& first = items[entries[begin].item];
+	bool isInstanced = first.instanceCount > 0;
+	if (first.indexType == 0 || first.setUniforms != NULL || (!isInstanced &&
+			!hasDrawParameters() && !GLEW_VERSION_4_2 && !GLEW_ARB_base_instance)){
+		return begin + 1;
+	}
+
+	uint64_t pass = entries[begin].key >> (64 - PassBits);
+	size_t end = begin + 1;
+	for (; end < entries.size() && end - begin < size_t(MaxDrawsPerRun); end++){
+		const drawItem& item = items[entries[end].item];
+		if ((entries[end].key >> (64 - PassBits)) != pass ||
+				item.program != first.program || item.vertexArray != first.vertexArray ||
+				item.texture != first.texture || item.mode != first.mode ||
+				item.indexType != first.indexType ||
+				(item.instanceCount > 0) != isInstanced || item.setUniforms != NULL){
+			break;
+		}
+	}
+	return end;
+}
+
+//----------------------------------------------------------------------------
+
+// Splits the sorted queue into runs, writing the indirect commands of each
+//   run of several draws and the data of each run that isn't instanced.
+//   A run whose commands or data don't fit is drawn one draw at a time,
+//   the data then going through the fallback buffer.
+void renderQueue::findRuns( streamRing& stream ){
+	bool isMultiDrawSupported = GLEW_VERSION_4_3 || GLEW_ARB_multi_draw_indirect;
+	if (uniformAlignment == 0){
+		glGetIntegerv( GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformAlignment );
+	}
+
+	runs.clear();
+	for (size_t begin = 0; begin < entries.size(); ){
+		size_t end = isMultiDrawSupported ? runEnd(begin) : begin + 1;
+
+		drawElementsCommand* commands = NULL;
+		size_t offset = NoCommands;
+		if (end - begin > 1){
+			commands = static_cast<drawElementsCommand*>( stream.allocate(
+				(end - begin) * sizeof(drawElementsCommand),
+				alignof(drawElementsCommand), offset ) );
+			if (commands == NULL){
+				end = begin + 1;
+			}
+		}
+
+		// The whole Draws block is bound, however few draws use it
+		size_t dataOffset = NoData;
+		if (items[entries[begin].item].instanceCount == 0){
+			drawData* data = static_cast<drawData*>( stream.allocate(
+				MaxDrawsPerRun * sizeof(drawData), uniformAlignment, dataOffset ) );
+			if (data == NULL){
+				end = begin + 1;
+				commands = NULL;
+				offset = NoCommands;
+				dataOffset = FallbackData;
+			}
+			for (size_t i = begin; data != NULL && i < end; i++){
+				data[i - begin] = itemData[entries[i].item];
+			}
+		}
+
+		for (size_t i = begin; commands != NULL && i < end; i++){
+			const drawItem& item = items[entries[i].item];
+			drawElementsCommand& command = commands[i - begin];
+			command.count = item.count;
+			command.firstIndex = item.first / componentSize(item.indexType);
+			command.baseVertex = 0;
+			if (item.instanceCount > 0){
+				command.instanceCount = item.instanceCount;
+				command.baseInstance = item.baseInstance;
+			}
+			else {
+				command.instanceCount = 1;
+				command.baseInstance = hasDrawParameters() ? 0 : i - begin;
+			}
+		}
+		drawRun run = { begin, end, offset, dataOffset };
+		runs.push_back(run);
+		begin = end;
+	}
+}
+
+//----------------------------------------------------------------------------
+
+void renderQueue::flush( glStateCache& gl, streamRing& stream ){
+	sort();
+	findRuns( stream );
+	stream.commit();
+
+	for (size_t r = 0; r < runs.size(); r++){
+		const drawRun& run = runs[r];
+		const drawItem& item = items[entries[run.begin].item];
+
+		bool isOpaque = (entries[run.begin].key >> (64 - PassBits)) == OpaquePass;
+		gl.setBlend( !isOpaque );
+		gl.setDepthMask( isOpaque );
+		if (!isOpaque){
+			gl.blendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
+		}
+
+		gl.useProgram( item.program );
+		gl.bindVertexArray( item.vertexArray );
+		if (item.texture != 0){
+			gl.activeTexture( GL_TEXTURE0 );
+			gl.bindTexture2D( item.texture );
+		}
+		if (item.setUniforms != NULL){
+			item.setUniforms();
+		}
+		if (run.data == FallbackData){
+			if (fallbackBuffer == 0){
+				glGenBuffers( 1,&fallbackBuffer );
+				glBindBuffer( GL_UNIFORM_BUFFER,fallbackBuffer );
+				glBufferData( GL_UNIFORM_BUFFER,MaxDrawsPerRun * sizeof(drawData),NULL,
+					GL_DYNAMIC_DRAW );
+				std::cerr << "Draw data overflowed the stream ring; drawing one at a time"
+					<< std::endl;
+			}
+			glBindBuffer( GL_UNIFORM_BUFFER,fallbackBuffer );
+			glBufferSubData( GL_UNIFORM_BUFFER,0,sizeof(drawData),
+				&itemData[entries[run.begin].item] );
+			glBindBufferRange( GL_UNIFORM_BUFFER, drawsBinding, fallbackBuffer, 0,
+				MaxDrawsPerRun * sizeof(drawData) );
+		}
+		else if (run.data != NoData){
+			glBindBufferRange( GL_UNIFORM_BUFFER, drawsBinding, stream.name(), run.data,
+				MaxDrawsPerRun * sizeof(drawData) );
+		}
+
+		if (run.commands != NoCommands){
+			glBindBuffer( GL_DRAW_INDIRECT_BUFFER, stream.name() );
+			glMultiDrawElementsIndirect( item.mode, item.indexType,
+				BUFFER_OFFSET(run.commands), GLsizei(run.end - run.begin), 0 );
+		}
+		else if (item.baseInstance != 0){
+			if (item.indexType == 0){
+				glDrawArraysInstancedBaseInstance( item.mode, item.first, item.count,
+					item.instanceCount, item.baseInstance );
+			}
+			else {
+				glDrawElementsInstancedBaseInstance( item.mode, item.count,
+					item.indexType, BUFFER_OFFSET(item.first), item.instanceCount,
+					item.baseInstance );
+			}
+		}
+		else if (item.instanceCount > 0){
+			if (item.indexType == 0){
+				glDrawArraysInstanced( item.mode, item.first, item.count,
+					item.instanceCount );
+			}
+			else {
+				glDrawElementsInstanced( item.mode, item.count, item.indexType,
+					BUFFER_OFFSET(item.first), item.instanceCount );
+			}
+		}
+		else if (item.indexType == 0){
+			glDrawArrays( item.mode, item.first, item.count );
+		}
+		else {
+			glDrawElements( item.mode, item.count, item.indexType,
+				BUFFER_OFFSET(item.first) );
+		}
+	}
+
+	items.clear();
+	itemData.clear();
+	entries.clear();
+}
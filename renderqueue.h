@@ -0,0 +1,162 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  --- renderqueue.h ---
+//
+//   Draws submitted during a frame, ordered by a 64-bit sort key so that
+//     opaque objects are drawn grouped by state and front to back, then
+//     transparent ones back to front.  Neighbouring draws that share all
+//     their state go out as one multi-draw, each reading its own transform
+//     and material from a shared uniform buffer.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef __RENDERQUEUE_H__
+#define __RENDERQUEUE_H__
+
+#include "Angel.h"
+#include "glstate.h"
+#include "streamring.h"
+#include <vector>
+#include <stdint.h>
+
+//  Passes, in the order they are drawn
+enum renderPass{
+	OpaquePass,		// depth written, no blending
+	TransparentPass		// blended over what's drawn, depth only tested
+};
+
+//  Most draws one multi-draw sends, and the length of the draws array of
+//    the Draws block in draws.glsl
+const int MaxDrawsPerRun = 16;
+
+//  Whether the draws of a multi-draw are told apart by gl_DrawIDARB.
+//    Otherwise draws.glsl reads in_drawIndex, which vertex arrays feed
+//    from MaxDrawsPerRun floats counting up from 0, with a divisor of 1,
+//    so that each draw's baseInstance picks its entry.
+inline bool hasDrawParameters( ){
+	return GLEW_ARB_shader_draw_parameters;
+}
+
+//  Transform and material of one draw, as the std140, row_major Draws
+//    block in draws.glsl lays out its drawData
+struct drawData{
+	mat4    modelView;
+	vec4    normalMatrix[3];	// rows, padded as std140 pads a mat3
+	vec4    tint;			// multiplies the object's color
+	GLfloat textured;		// 1 to color by the texture, 0 by the vertices
+	GLfloat unused[3];
+
+	drawData() : textured(0.0) {}
+
+	//  For a lit object, whose normals are turned by normal
+	drawData( const mat4& modelView, const mat3& normal, const vec4& tint );
+
+	//  For an unlit one, which leaves normalMatrix zero
+	drawData( const mat4& modelView, const vec4& tint, GLfloat textured );
+};
+
+static_assert(sizeof(drawData) == 9 * 4 * sizeof(GLfloat),
+	"drawData must match the std140 layout of drawData in draws.glsl");
+
+//  One draw call and the state it needs
+struct drawItem{
+	GLuint  program;
+	GLuint  vertexArray;
+	GLuint  texture;	// GL_TEXTURE_2D on unit 0, or 0 for none
+	GLenum  mode;
+	GLsizei count;
+	GLenum  indexType;	// 0 to draw with glDrawArrays()
+	size_t  first;		// first vertex, or byte offset of the first index
+
+	// Sets the object's own uniforms once its program is in use, or NULL
+	void (*setUniforms)( );
+
+	GLsizei instanceCount;	// 0 for a draw that isn't instanced
+
+	// Instance that per-instance attributes start from.  Any but 0 needs
+	//   GL 4.2 or ARB_base_instance.
+	GLuint  baseInstance;
+};
+
+//  Sort keys are laid out, most significant bits first, as
+//
+//    opaque       pass:2  program:8  vertexArray:8  texture:8  depth:24
+//    transparent  pass:2  far-to-near depth:24  program:8  vertexArray:8  texture:8
+//
+//  followed by 14 unused bits.  Only the low 8 bits of each GL name are
+//    kept; names that share them are merely not grouped together.
+//
+//  Once sorted, each run of up to MaxDrawsPerRun indexed draws with the
+//    same pass and state and no setUniforms is written into the stream
+//    ring as indirect commands and drawn by one glMultiDrawElementsIndirect(),
+//    given GL 4.3 or ARB_multi_draw_indirect.  Instanced draws tell their
+//    instances apart by baseInstance.  The drawData submitted with draws
+//    that aren't instanced is copied, in the order they are drawn, into
+//    the stream ring and bound to the Draws block for the run; without
+//    draw parameters such draws need GL 4.2 or ARB_base_instance to run
+//    together, as each one's baseInstance is its position in the run.
+//    Should the ring fill up, the remaining draws go out one at a time,
+//    each uploading its data to a small buffer of the queue's own.
+class renderQueue{
+	struct sortEntry{
+		uint64_t key;
+		uint32_t item;
+	};
+
+	// Entries [begin, end) of the sorted queue, drawn by the indirect
+	//   commands at byte offset commands into the stream ring if there is
+	//   more than one, with their drawData at byte offset data, or in
+	//   fallbackBuffer
+	struct drawRun{
+		size_t begin, end;
+		size_t commands;
+		size_t data;
+	};
+
+	std::vector<drawItem>  items;
+	std::vector<drawData>  itemData;	// of each item
+	std::vector<sortEntry> entries, scratch;
+	std::vector<drawRun>   runs;
+
+	GLfloat maxDistance;
+	GLuint  drawsBinding;
+	GLint   uniformAlignment;	// of uniform buffer ranges, once looked up
+	GLuint  fallbackBuffer;		// Draws block of draws whose data didn't fit
+
+	void sort( );
+	size_t runEnd( size_t begin ) const;
+	void findRuns( streamRing& stream );
+
+public:
+	renderQueue() : maxDistance(1.0), drawsBinding(0), uniformAlignment(0),
+		fallbackBuffer(0) {}
+
+	//  Distance from the eye that maps to the deepest sort depth; anything
+	//    further sorts as if it were there
+	void setMaxDistance( GLfloat distance ) { maxDistance = distance; }
+
+	//  Uniform buffer binding the Draws block of every program is bound to
+	void setDrawsBinding( GLuint binding ) { drawsBinding = binding; }
+
+	//  Queues item, distance being how far it is from the eye, with the
+	//    data its shaders read from the Draws block
+	void submit( const drawItem& item, renderPass pass, GLfloat distance,
+		const drawData& data = drawData() );
+
+	//  Sorts and draws everything submitted since the last flush, setting
+	//    state through gl, and empties the queue.  The indirect commands
+	//    and draw data are allocated from stream, which is committed before
+	//    drawing; once it is full, the remaining draws go out one by one.
+	void flush( glStateCache& gl, streamRing& stream );
+
+	//  Sorts the queue, which mustn't be empty, without drawing or
+	//    emptying it, for benchmarking; returns the item drawn first
+	const drawItem& sortOnly( );
+
+	size_t size() const { return items.size(); }
+
+	//  Number of GL draw calls the last flush made
+	size_t drawCalls() const { return runs.size(); }
+};
+
+#endif // __RENDERQUEUE_H__
@@ -1,163 +1,322 @@
-// fragment shading of sphere model
+// sphere model built by subdividing a tetrahedron
+//
+// Rather than recursing into each triangle, the whole mesh is subdivided
+//   one level at a time.  A level with V vertices, E edges and F faces
+//   becomes one with V + E vertices, 2E + 3F edges and 4F faces, and every
+//   new element has a fixed slot:
+//
+//     - edge e gets midpoint vertex V + e and is split into edges 2e, 2e + 1
+//     - face f gets interior edges 2E + 3f + k and child faces 4f + k
+//
+//   No element depends on another of the same level, so edges and faces
+//   are processed in parallel without locks or shared counters.
 
-#include "Angel.h"
+#include "sphere.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <algorithm>
+#include <cstdlib>
 
-class sphere{
-private:
-	const int NumTimesToSubdivide = 5;
-	const int NumTriangles        = 4096;  // (4 faces)^(NumTimesToSubdivide + 1)
-	const int NumVertices         = 3 * NumTriangles;
-
-	typedef Angel::vec4 point4;
-	typedef Angel::vec4 color4;
+struct edge{
+	GLuint a, b;
+};
 
-	point4 points[NumVertices];
-	vec3   normals[NumVertices];
+// e[k] joins v[k] and v[(k + 1) % 3]
+struct face{
+	GLuint v[3];
+	GLuint e[3];
+};
 
-    // Model-view and projection matrices uniform location
-	GLuint  ModelView, Projection;
+// Work is split into chunks of this many items; smaller jobs run inline
+const size_t ItemsPerChunk = 2048;
 
-    //----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
 
-	int Index = 0;
+// Fixed set of worker threads that run chunks of a parallelFor() job
+//   alongside the calling thread.  The pool runs one job at a time, so a
+//   second thread calling parallelFor() waits for the first one's job.
+class workerPool{
+private:
+	std::vector<std::thread> workers;
+	std::mutex jobLock;	// held by the thread whose job is running
+	std::mutex lock;
+	std::condition_variable wake, done;
 
-	void triangle( const point4& a, const point4& b, const point4& c ) {
-		vec3  normal = normalize( cross(b - a, c - b) );
+	const std::function<void(size_t, size_t)>* job;
+	size_t jobSize;
+	std::atomic<size_t> nextChunk;
+	size_t busyWorkers;
+	unsigned generation;
+	bool isStopping;
 
-		normals[Index] = normal;  points[Index] = a;  Index++;
-		normals[Index] = normal;  points[Index] = b;  Index++;
-		normals[Index] = normal;  points[Index] = c;  Index++;
+	void runChunks(){
+		size_t begin;
+		while ((begin = ItemsPerChunk * nextChunk++) < jobSize){
+			(*job)(begin, std::min(begin + ItemsPerChunk, jobSize));
+		}
 	}
 
-    //----------------------------------------------------------------------------
-
-	point4 unit( const point4& p ) {
-		float len = p.x*p.x + p.y*p.y + p.z*p.z;
-    
-		point4 t;
-		if ( len > DivideByZeroTolerance ) {
-			t = p / sqrt(len);
-			t.w = 1.0;
+	void workerLoop(){
+		unsigned seen = 0;
+		std::unique_lock<std::mutex> guard(lock);
+		while (true){
+			wake.wait(guard, [&](){ return generation != seen || isStopping; });
+			if (isStopping){
+				return;
+			}
+			seen = generation;
+			guard.unlock();
+			runChunks();
+			guard.lock();
+			if (--busyWorkers == 0){
+				done.notify_one();
+			}
 		}
+	}
 
-		return t;
+public:
+	workerPool() : job(NULL), jobSize(0), nextChunk(0), busyWorkers(0),
+		generation(0), isStopping(false){
+		// SPHERE_THREADS overrides the number of threads, caller included
+		unsigned n = std::thread::hardware_concurrency();
+		const char* threads = getenv("SPHERE_THREADS");
+		if (threads != NULL && atoi(threads) > 0){
+			n = atoi(threads);
+		}
+		for (unsigned i = 1; i < n; i++){
+			workers.push_back(std::thread(&workerPool::workerLoop, this));
+		}
 	}
 
-	void divide_triangle( const point4& a, const point4& b,
-						  const point4& c, int count ){
-		if ( count > 0 ) {
-			point4 v1 = unit( a + b );
-			point4 v2 = unit( a + c );
-			point4 v3 = unit( b + c );
-			divide_triangle(  a, v1, v2, count - 1 );
-			divide_triangle(  c, v2, v3, count - 1 );
-			divide_triangle(  b, v3, v1, count - 1 );
-			divide_triangle( v1, v3, v2, count - 1 );
+	~workerPool(){
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			isStopping = true;
 		}
-		else {
-			triangle( a, b, c );
+		wake.notify_all();
+		for (size_t i = 0; i < workers.size(); i++){
+			workers[i].join();
 		}
 	}
 
-	void tetrahedron( int count ){
-		point4 v[4] = {
-			vec4( 0.0, 0.0, 1.0, 1.0 ),
-			vec4( 0.0, 0.942809, -0.333333, 1.0 ),
-			vec4( -0.816497, -0.471405, -0.333333, 1.0 ),
-			vec4( 0.816497, -0.471405, -0.333333, 1.0 )
-		};
-
-		divide_triangle( v[0], v[1], v[2], count );
-		divide_triangle( v[3], v[2], v[1], count );
-		divide_triangle( v[0], v[3], v[1], count );
-		divide_triangle( v[0], v[2], v[3], count );
+	// Calls f(begin, end) over chunks covering [0, n) and returns when
+	//   every chunk has finished
+	void parallelFor( size_t n, const std::function<void(size_t, size_t)>& f ){
+		if (workers.empty() || n <= ItemsPerChunk){
+			f(0, n);
+			return;
+		}
+
+		std::lock_guard<std::mutex> running(jobLock);
+		std::unique_lock<std::mutex> guard(lock);
+		job = &f;
+		jobSize = n;
+		nextChunk = 0;
+		busyWorkers = workers.size();
+		generation++;
+		wake.notify_all();
+		guard.unlock();
+
+		runChunks();
+
+		guard.lock();
+		done.wait(guard, [&](){ return busyWorkers == 0; });
 	}
+};
 
-    //----------------------------------------------------------------------------
-public:
-    // OpenGL initialization
-	void init(){
-		// Subdivide a tetrahedron into a sphere
-		tetrahedron( NumTimesToSubdivide );
-
-		// Create a vertex array object
-		GLuint vao;
-		glGenVertexArrays( 1, &vao );
-		glBindVertexArray( vao );
-
-		// Create and initialize a buffer object
-		GLuint buffer;
-		glGenBuffers( 1, &buffer );
-		glBindBuffer( GL_ARRAY_BUFFER, buffer );
-		glBufferData( GL_ARRAY_BUFFER, sizeof(points) + sizeof(normals),
-					  NULL, GL_STATIC_DRAW );
-		glBufferSubData( GL_ARRAY_BUFFER, 0, sizeof(points), points );
-		glBufferSubData( GL_ARRAY_BUFFER, sizeof(points),
-						 sizeof(normals), normals );
-
-		// Load shaders and use the resulting shader program
-		GLuint program = InitShader( "vshader56.glsl", "fshader56.glsl" );
-		glUseProgram( program );
-	
-		// set up vertex arrays
-		GLuint vPosition = glGetAttribLocation( program, "vPosition" );
-		glEnableVertexAttribArray( vPosition );
-		glVertexAttribPointer( vPosition, 4, GL_FLOAT, GL_FALSE, 0,
-							   BUFFER_OFFSET(0) );
-
-		GLuint vNormal = glGetAttribLocation( program, "vNormal" ); 
-		glEnableVertexAttribArray( vNormal );
-		glVertexAttribPointer( vNormal, 3, GL_FLOAT, GL_FALSE, 0,
-							   BUFFER_OFFSET(sizeof(points)) );
-
-		// Initialize shader lighting parameters
-		point4 light_position( 0.0, 0.0, 2.0, 0.0 );
-		color4 light_ambient( 0.2, 0.2, 0.2, 1.0 );
-		color4 light_diffuse( 1.0, 1.0, 1.0, 1.0 );
-		color4 light_specular( 1.0, 1.0, 1.0, 1.0 );
-
-		color4 material_ambient( 1.0, 0.0, 1.0, 1.0 );
-		color4 material_diffuse( 1.0, 0.8, 0.0, 1.0 );
-		color4 material_specular( 1.0, 0.0, 1.0, 1.0 );
-		float  material_shininess = 5.0;
-
-		color4 ambient_product = light_ambient * material_ambient;
-		color4 diffuse_product = light_diffuse * material_diffuse;
-		color4 specular_product = light_specular * material_specular;
-
-		glUniform4fv( glGetUniformLocation(program, "AmbientProduct"),
-					  1, ambient_product );
-		glUniform4fv( glGetUniformLocation(program, "DiffuseProduct"),
-					  1, diffuse_product );
-		glUniform4fv( glGetUniformLocation(program, "SpecularProduct"),
-					  1, specular_product );
-	
-		glUniform4fv( glGetUniformLocation(program, "LightPosition"),
-					  1, light_position );
-
-		glUniform1f( glGetUniformLocation(program, "Shininess"),
-					 material_shininess );
-		 
-		// Retrieve transformation uniform variable locations
-		ModelView = glGetUniformLocation( program, "ModelView" );
-		Projection = glGetUniformLocation( program, "Projection" );
-    
-		glEnable( GL_DEPTH_TEST );
-    
-		glClearColor( 1.0, 1.0, 1.0, 1.0 ); /* white background */
+//----------------------------------------------------------------------------
+
+point4 unit( const point4& p ){
+	float len = p.x*p.x + p.y*p.y + p.z*p.z;
+
+	point4 t;
+	if ( len > DivideByZeroTolerance ) {
+		t = p / sqrt(len);
+		t.w = 1.0;
 	}
 
-    //----------------------------------------------------------------------------
+	return t;
+}
+
+// The half of edge e that touches vertex v
+inline GLuint halfEdge( const std::vector<edge>& edges, GLuint e, GLuint v ){
+	return edges[e].a == v ? 2*e : 2*e + 1;
+}
+
+// Splits every edge and face of one level into the slots described above
+void subdivide( workerPool& pool, std::vector<point4>& points,
+		std::vector<edge>& edges, std::vector<face>& faces ){
+	const GLuint V = points.size(), E = edges.size(), F = faces.size();
+
+	std::vector<edge> newEdges(2*E + 3*F);
+	std::vector<face> newFaces(4*F);
+	points.resize(V + E);
+
+	pool.parallelFor(E, [&](size_t begin, size_t end){
+		for (size_t e = begin; e < end; e++){
+			GLuint a = edges[e].a, b = edges[e].b, m = V + e;
+			points[m] = unit( points[a] + points[b] );
+			newEdges[2*e] = { a, m };
+			newEdges[2*e + 1] = { m, b };
+		}
+	});
+
+	pool.parallelFor(F, [&](size_t begin, size_t end){
+		for (size_t f = begin; f < end; f++){
+			const face& t = faces[f];
+			GLuint a = t.v[0], b = t.v[1], c = t.v[2];
+			GLuint v1 = V + t.e[0], v2 = V + t.e[2], v3 = V + t.e[1];
+			GLuint i0 = 2*E + 3*f, i1 = i0 + 1, i2 = i0 + 2;
+
+			newEdges[i0] = { v1, v2 };
+			newEdges[i1] = { v2, v3 };
+			newEdges[i2] = { v3, v1 };
+
+			// Same children, in the same order, as the recursive version
+			newFaces[4*f]     = { { a, v1, v2 },
+				{ halfEdge(edges, t.e[0], a), i0, halfEdge(edges, t.e[2], a) } };
+			newFaces[4*f + 1] = { { c, v2, v3 },
+				{ halfEdge(edges, t.e[2], c), i1, halfEdge(edges, t.e[1], c) } };
+			newFaces[4*f + 2] = { { b, v3, v1 },
+				{ halfEdge(edges, t.e[1], b), i2, halfEdge(edges, t.e[0], b) } };
+			newFaces[4*f + 3] = { { v1, v3, v2 }, { i2, i1, i0 } };
+		}
+	});
+
+	edges.swap(newEdges);
+	faces.swap(newFaces);
+}
 
-	void display( void ){
-		point4 at( 0.0, 0.0, 0.0, 1.0 );
-		point4 eye( 0.0, 0.0, 2.0, 1.0 );
-		vec4   up( 0.0, 1.0, 0.0, 0.0 );
+//----------------------------------------------------------------------------
 
-		mat4 model_view = LookAt( eye, at, up );
-		glUniformMatrix4fv( ModelView, 1, GL_TRUE, model_view );
+// Appends the triangles of one level to mesh.indices
+void appendLevel( workerPool& pool, sphereMesh& mesh, int level,
+		  const std::vector<face>& faces ){
+	sphereLOD lod = { level, GLuint(mesh.indices.size()), GLuint(3*faces.size()) };
+	mesh.lods.push_back(lod);
+	mesh.indices.resize(lod.first + lod.count);
 
-		glDrawArrays( GL_TRIANGLES, 0, NumVertices );
-		glutSwapBuffers();
+	GLuint* out = &mesh.indices[lod.first];
+	pool.parallelFor(faces.size(), [&](size_t begin, size_t end){
+		for (size_t f = begin; f < end; f++){
+			std::copy(faces[f].v, faces[f].v + 3, out + 3*f);
+		}
+	});
+}
+
+//----------------------------------------------------------------------------
+
+sphereMesh tetrahedron( int count, int firstLevel ){
+	static workerPool pool;
+
+	sphereMesh mesh;
+	mesh.points = {
+		vec4( 0.0, 0.0, 1.0, 1.0 ),
+		vec4( 0.0, 0.942809, -0.333333, 1.0 ),
+		vec4( -0.816497, -0.471405, -0.333333, 1.0 ),
+		vec4( 0.816497, -0.471405, -0.333333, 1.0 )
+	};
+
+	// The six edges of the tetrahedron and the faces that use them
+	std::vector<edge> edges = {
+		{ 0, 1 }, { 0, 2 }, { 0, 3 }, { 1, 2 }, { 2, 3 }, { 3, 1 }
+	};
+	std::vector<face> faces = {
+		{ { 0, 1, 2 }, { 0, 3, 1 } },
+		{ { 3, 2, 1 }, { 4, 3, 5 } },
+		{ { 0, 3, 1 }, { 2, 5, 0 } },
+		{ { 0, 2, 3 }, { 1, 4, 2 } }
+	};
+
+	for (int level = 0; level <= count; level++){
+		if (level > 0){
+			subdivide(pool, mesh.points, edges, faces);
+		}
+		if (level >= firstLevel){
+			appendLevel(pool, mesh, level, faces);
+		}
+	}
+
+	// On a unit sphere the smooth normal is the position itself
+	mesh.normals.resize(mesh.points.size());
+	pool.parallelFor(mesh.points.size(), [&](size_t begin, size_t end){
+		for (size_t i = begin; i < end; i++){
+			mesh.normals[i] = vec3( mesh.points[i].x, mesh.points[i].y, mesh.points[i].z );
+		}
+	});
+
+	return mesh;
+}
+
+//----------------------------------------------------------------------------
+
+vertexFormat sphereFormat( sphereLayout layout, size_t count ){
+	vertexFormat format;
+	switch (layout){
+	case SphereSeparate: {
+		vertexAttrib position = { "in_position", 4, GL_FLOAT, GL_FALSE, 0, 0 };
+		vertexAttrib normal = { "in_normals", 3, GL_FLOAT, GL_FALSE,
+			count * sizeof(point4), 0 };
+		format.attribs = { position, normal };
+		format.bytesPerVertex = sizeof(point4) + sizeof(vec3);
+		break;
+	}
+	case SphereInterleaved:
+		format = interleaved({
+			{ "in_position", 3, GL_FLOAT, GL_FALSE, 0, 0 },
+			{ "in_normals",  2, GL_SHORT, GL_TRUE,  0, 0 } });
+		break;
+	case SphereHalf:
+		// w is stored too, as the stride would be padded to 8 bytes anyway
+		format = interleaved({
+			{ "in_position", 4, GL_HALF_FLOAT, GL_FALSE, 0, 0 } });
+		break;
+	}
+	return format;
+}
+
+//----------------------------------------------------------------------------
+
+sphereVertices packSphere( sphereLayout layout, const point4* points,
+			   const vec3* normals, size_t count ){
+	sphereVertices packed;
+	packed.format = sphereFormat(layout, count);
+	packed.normals = layoutNormals(layout);
+	packed.data.resize(count * packed.format.bytesPerVertex);
+
+	switch (layout){
+	case SphereSeparate: {
+		size_t pointsSize = count * sizeof(point4);
+		memcpy(&packed.data[0], points, pointsSize);
+		memcpy(&packed.data[pointsSize], normals, count * sizeof(vec3));
+		break;
+	}
+	case SphereInterleaved: {
+		struct vertex{ GLfloat position[3]; GLshort normal[2]; };
+		vertex* out = reinterpret_cast<vertex*>(packed.data.data());
+		for (size_t i = 0; i < count; i++){
+			out[i].position[0] = points[i].x;
+			out[i].position[1] = points[i].y;
+			out[i].position[2] = points[i].z;
+			octEncode(normals[i], out[i].normal);
+		}
+		break;
 	}
+	case SphereHalf: {
+		struct vertex{ GLushort position[4]; };
+		vertex* out = reinterpret_cast<vertex*>(packed.data.data());
+		for (size_t i = 0; i < count; i++){
+			out[i].position[0] = toHalf(points[i].x);
+			out[i].position[1] = toHalf(points[i].y);
+			out[i].position[2] = toHalf(points[i].z);
+			out[i].position[3] = toHalf(points[i].w);
+		}
+		break;
+	}
+	}
+
+	return packed;
 }
@@ -0,0 +1,96 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  --- sphere.h ---
+//
+//   Unit sphere built by subdividing a tetrahedron
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef __SPHERE_H__
+#define __SPHERE_H__
+
+#include "Angel.h"
+#include "vertexformat.h"
+#include <vector>
+
+typedef Angel::vec4 point4;
+
+//  Range of sphereMesh::indices holding the triangles of one level
+struct sphereLOD{
+	int    level;
+	GLuint first;
+	GLuint count;
+};
+
+//  Shared vertices, with smooth normals, and the triangle lists that index
+//    them for glDrawElements().  Subdividing splits every edge once, so a
+//    tetrahedron subdivided n times has 2*4^n + 2 vertices and 4^(n+1)
+//    triangles; up to n = 7 every index fits in a GLushort.
+struct sphereMesh{
+	std::vector<point4>    points;
+	std::vector<vec3>      normals;
+	std::vector<GLuint>    indices;
+	std::vector<sphereLOD> lods;	// coarsest first
+};
+
+//  Returns a tetrahedron subdivided count times, with the triangles of
+//    every level from firstLevel to count one after another in indices.
+//    The vertices of each level are a prefix of the next level's, so all
+//    of the levels share the one vertex array.  Each level is computed in
+//    parallel across the hardware threads, or SPHERE_THREADS threads if
+//    that is set.  Calls from several threads are safe, and take turns
+//    using the threads.
+sphereMesh tetrahedron( int count, int firstLevel );
+
+inline sphereMesh tetrahedron( int count ){
+	return tetrahedron( count, count );
+}
+
+//----------------------------------------------------------------------------
+//
+//  --- Vertex layouts ---
+//
+
+//  Ways of storing a sphere's vertices in a buffer, largest first
+enum sphereLayout{
+	SphereSeparate,		// point4 positions, then vec3 normals:     28 bytes
+	SphereInterleaved,	// vec3 position and octahedral normal:     16 bytes
+	SphereHalf		// half float position; normal is the same:  8 bytes
+};
+
+//  Names of the layouts on command lines, in the order above
+const char* const SphereLayoutNames[] = { "separate", "interleaved", "half" };
+const int NumSphereLayouts = 3;
+
+//  How vshaderB gets each normal, defined as its NORMAL_ENCODING
+enum sphereNormals{
+	NormalsFloat,		// in_normals
+	NormalsOctahedral,	// octDecode(in_normals.xy)
+	NormalsFromPosition	// in_position.xyz, exact for a unit sphere
+};
+
+//  How layout stores normals, known before anything is packed
+inline sphereNormals layoutNormals( sphereLayout layout ){
+	switch (layout){
+	case SphereInterleaved:	return NormalsOctahedral;
+	case SphereHalf:	return NormalsFromPosition;
+	default:		return NormalsFloat;
+	}
+}
+
+//  A sphere's vertices packed for glBufferData(), and where each of its
+//    attributes lies in them
+struct sphereVertices{
+	std::vector<GLubyte> data;
+	vertexFormat         format;
+	sphereNormals        normals;
+};
+
+//  Where layout puts each attribute of count vertices
+vertexFormat sphereFormat( sphereLayout layout, size_t count );
+
+//  Packs count points and normals into layout
+sphereVertices packSphere( sphereLayout layout, const point4* points,
+			   const vec3* normals, size_t count );
+
+#endif // __SPHERE_H__
@@ -0,0 +1,92 @@
+// ring of per-frame regions in one streaming buffer
+
+#include "streamring.h"
+
+// How long to wait for the GPU at a time before checking again
+const GLuint64 FenceTimeoutNs = 1000000;
+
+//----------------------------------------------------------------------------
+
+streamRing::streamRing()
+	: buffer(0), mapped(NULL), isPersistent(false), regionSize(0), region(0), used(0)
+{
+	for (int i = 0; i < StreamFramesInFlight; i++){
+		fences[i] = 0;
+	}
+}
+
+//----------------------------------------------------------------------------
+
+void streamRing::create( size_t bytesPerFrame ){
+	regionSize = bytesPerFrame;
+	size_t size = regionSize * StreamFramesInFlight;
+
+	glGenBuffers( 1,&buffer );
+	glBindBuffer( GL_ARRAY_BUFFER,buffer );
+
+	isPersistent = GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage;
+	if (isPersistent){
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage( GL_ARRAY_BUFFER,size,NULL,flags );
+		mapped = static_cast<GLubyte*>( glMapBufferRange( GL_ARRAY_BUFFER,0,size,flags ) );
+	}
+	else {
+		glBufferData( GL_ARRAY_BUFFER,size,NULL,GL_STREAM_DRAW );
+	}
+
+	// beginFrame() moves on to region 0
+	region = StreamFramesInFlight - 1;
+	used = regionSize;
+}
+
+//----------------------------------------------------------------------------
+
+void streamRing::beginFrame( ){
+	region = (region + 1) % StreamFramesInFlight;
+	used = 0;
+
+	if (fences[region] != 0){
+		while (glClientWaitSync( fences[region], GL_SYNC_FLUSH_COMMANDS_BIT,
+				FenceTimeoutNs ) == GL_TIMEOUT_EXPIRED){
+		}
+		glDeleteSync( fences[region] );
+		fences[region] = 0;
+	}
+
+	if (!isPersistent){
+		// The fence already guarantees the GPU is done with the region
+		glBindBuffer( GL_ARRAY_BUFFER,buffer );
+		mapped = static_cast<GLubyte*>( glMapBufferRange( GL_ARRAY_BUFFER,
+			region * regionSize, regionSize, GL_MAP_WRITE_BIT |
+			GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT ) );
+	}
+}
+
+//----------------------------------------------------------------------------
+
+void* streamRing::allocate( size_t size, size_t alignment, size_t& offset ){
+	size_t start = (used + alignment - 1) / alignment * alignment;
+	if (mapped == NULL || start + size > regionSize){
+		return NULL;
+	}
+	used = start + size;
+
+	offset = region * regionSize + start;
+	return isPersistent ? mapped + offset : mapped + start;
+}
+
+//----------------------------------------------------------------------------
+
+void streamRing::commit( ){
+	if (!isPersistent && mapped != NULL){
+		glBindBuffer( GL_ARRAY_BUFFER,buffer );
+		glUnmapBuffer( GL_ARRAY_BUFFER );
+		mapped = NULL;
+	}
+}
+
+//----------------------------------------------------------------------------
+
+void streamRing::endFrame( ){
+	fences[region] = glFenceSync( GL_SYNC_GPU_COMMANDS_COMPLETE,0 );
+}
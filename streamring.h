@@ -0,0 +1,60 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  --- streamring.h ---
+//
+//   Buffer that per-frame data is written straight into, split into one
+//     region per frame in flight so the GPU never reads what is being
+//     written
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef __STREAMRING_H__
+#define __STREAMRING_H__
+
+#include "Angel.h"
+
+//  Frames the CPU may get ahead of the GPU by
+const int StreamFramesInFlight = 3;
+
+//  Each frame, between beginFrame() and commit(), allocate() hands out
+//    space in that frame's region.  Once the frame's draws have been
+//    issued, endFrame() fences the region, and it is only written again
+//    after the GPU has passed the fence.
+//
+//  With GL 4.4 or ARB_buffer_storage the buffer is mapped once, persistent
+//    and coherent.  Otherwise each region is mapped unsynchronized while
+//    it is written and unmapped by commit(), which the fences make safe.
+class streamRing{
+	GLuint   buffer;
+	GLubyte* mapped;	// start of the buffer, or of the region if not persistent
+	bool     isPersistent;
+	size_t   regionSize;
+	int      region;
+	size_t   used;
+	GLsync   fences[StreamFramesInFlight];
+
+public:
+	streamRing();
+
+	//  Creates the buffer, with bytesPerFrame for each frame in flight
+	void create( size_t bytesPerFrame );
+
+	//  Waits until the GPU is done with the next region, and starts
+	//    handing it out
+	void beginFrame( );
+
+	//  Returns space for size bytes aligned to alignment, and sets offset
+	//    to its position in the buffer, or returns NULL if this frame's
+	//    region is full
+	void* allocate( size_t size, size_t alignment, size_t& offset );
+
+	//  Makes this frame's writes visible to GL; call before drawing
+	void commit( );
+
+	//  Fences the frame's region once the draws using it have been issued
+	void endFrame( );
+
+	GLuint name() const { return buffer; }
+};
+
+#endif // __STREAMRING_H__
@@ -7,6 +7,7 @@
 #ifndef __ANGEL_VEC_H__
 #define __ANGEL_VEC_H__
 
+#include <type_traits>
 #include "Angel.h"
 
 namespace Angel {
@@ -16,7 +17,7 @@ namespace Angel {
 //  vec2.h - 2D vector
 //
 
-struct vec2 {
+struct alignas(8) vec2 {
 
     GLfloat  x;
     GLfloat  y;
@@ -25,42 +26,39 @@ struct vec2 {
     //  --- Constructors and Destructors ---
     //
 
-    vec2( GLfloat s = GLfloat(0.0) ) :
+    constexpr vec2( GLfloat s = GLfloat(0.0) ) :
 	x(s), y(s) {}
 
-    vec2( GLfloat x, GLfloat y ) :
+    constexpr vec2( GLfloat x, GLfloat y ) :
 	x(x), y(y) {}
 
-    vec2( const vec2& v )
-	{ x = v.x;  y = v.y;  }
-
     //
     //  --- Indexing Operator ---
     //
 
     GLfloat& operator [] ( int i ) { return *(&x + i); }
-    const GLfloat operator [] ( int i ) const { return *(&x + i); }
+    constexpr GLfloat operator [] ( int i ) const { return i == 0 ? x : y; }
 
     //
     //  --- (non-modifying) Arithematic Operators ---
     //
 
-    vec2 operator - () const // unary minus operator
+    constexpr vec2 operator - () const // unary minus operator
 	{ return vec2( -x, -y ); }
 
-    vec2 operator + ( const vec2& v ) const
+    constexpr vec2 operator + ( const vec2& v ) const
 	{ return vec2( x + v.x, y + v.y ); }
 
-    vec2 operator - ( const vec2& v ) const
+    constexpr vec2 operator - ( const vec2& v ) const
 	{ return vec2( x - v.x, y - v.y ); }
 
-    vec2 operator * ( const GLfloat s ) const
+    constexpr vec2 operator * ( const GLfloat s ) const
 	{ return vec2( s*x, s*y ); }
 
-    vec2 operator * ( const vec2& v ) const
+    constexpr vec2 operator * ( const vec2& v ) const
 	{ return vec2( x*v.x, y*v.y ); }
 
-    friend vec2 operator * ( const GLfloat s, const vec2& v )
+    friend constexpr vec2 operator * ( const GLfloat s, const vec2& v )
 	{ return v * s; }
 
     vec2 operator / ( const GLfloat s ) const {
@@ -133,7 +131,7 @@ struct vec2 {
 //  Non-class vec2 Methods
 //
 
-inline
+inline constexpr
 GLfloat dot( const vec2& u, const vec2& v ) {
     return u.x * v.x + u.y * v.y;
 }
@@ -164,43 +162,43 @@ struct vec3 {
     //  --- Constructors and Destructors ---
     //
 
-    vec3( GLfloat s = GLfloat(0.0) ) :
+    constexpr vec3( GLfloat s = GLfloat(0.0) ) :
 	x(s), y(s), z(s) {}
 
-    vec3( GLfloat x, GLfloat y, GLfloat z ) :
+    constexpr vec3( GLfloat x, GLfloat y, GLfloat z ) :
 	x(x), y(y), z(z) {}
 
-    vec3( const vec3& v ) { x = v.x;  y = v.y;  z = v.z; }
-
-    vec3( const vec2& v, const float f ) { x = v.x;  y = v.y;  z = f; }
+    constexpr vec3( const vec2& v, const float f ) :
+	x(v.x), y(v.y), z(f) {}
 
     //
     //  --- Indexing Operator ---
     //
 
     GLfloat& operator [] ( int i ) { return *(&x + i); }
-    const GLfloat operator [] ( int i ) const { return *(&x + i); }
+    constexpr GLfloat operator [] ( int i ) const
+	{ return i == 0 ? x : i == 1 ? y : z; }
 
     //
     //  --- (non-modifying) Arithematic Operators ---
     //
 
-    vec3 operator - () const  // unary minus operator
+    constexpr vec3 operator - () const  // unary minus operator
 	{ return vec3( -x, -y, -z ); }
 
-    vec3 operator + ( const vec3& v ) const
+    constexpr vec3 operator + ( const vec3& v ) const
 	{ return vec3( x + v.x, y + v.y, z + v.z ); }
 
-    vec3 operator - ( const vec3& v ) const
+    constexpr vec3 operator - ( const vec3& v ) const
 	{ return vec3( x - v.x, y - v.y, z - v.z ); }
 
-    vec3 operator * ( const GLfloat s ) const
+    constexpr vec3 operator * ( const GLfloat s ) const
 	{ return vec3( s*x, s*y, s*z ); }
 
-    vec3 operator * ( const vec3& v ) const
+    constexpr vec3 operator * ( const vec3& v ) const
 	{ return vec3( x*v.x, y*v.y, z*v.z ); }
 
-    friend vec3 operator * ( const GLfloat s, const vec3& v )
+    friend constexpr vec3 operator * ( const GLfloat s, const vec3& v )
 	{ return v * s; }
 
     vec3 operator / ( const GLfloat s ) const {
@@ -273,7 +271,7 @@ struct vec3 {
 //  Non-class vec3 Methods
 //
 
-inline
+inline constexpr
 GLfloat dot( const vec3& u, const vec3& v ) {
     return u.x*v.x + u.y*v.y + u.z*v.z ;
 }
@@ -288,7 +286,7 @@ vec3 normalize( const vec3& v ) {
     return v / length(v);
 }
 
-inline
+inline constexpr
 vec3 cross(const vec3& a, const vec3& b )
 {
     return vec3( a.y * b.z - a.z * b.y,
@@ -303,7 +301,7 @@ vec3 cross(const vec3& a, const vec3& b )
 //
 //////////////////////////////////////////////////////////////////////////////
 
-struct vec4 {
+struct alignas(16) vec4 {
 
     GLfloat  x;
     GLfloat  y;
@@ -314,47 +312,46 @@ struct vec4 {
     //  --- Constructors and Destructors ---
     //
 
-    vec4( GLfloat s = GLfloat(0.0) ) :
+    constexpr vec4( GLfloat s = GLfloat(0.0) ) :
 	x(s), y(s), z(s), w(s) {}
 
-    vec4( GLfloat x, GLfloat y, GLfloat z, GLfloat w ) :
+    constexpr vec4( GLfloat x, GLfloat y, GLfloat z, GLfloat w ) :
 	x(x), y(y), z(z), w(w) {}
 
-    vec4( const vec4& v ) { x = v.x;  y = v.y;  z = v.z;  w = v.w; }
-
-    vec4( const vec3& v, const float s = 1.0 ) : w(w)
-	{ x = v.x;  y = v.y;  z = v.z; }
+    constexpr vec4( const vec3& v, const float s = 1.0 ) :
+	x(v.x), y(v.y), z(v.z), w(s) {}
 
-    vec4( const vec2& v, const float z, const float w ) : z(z), w(w)
-	{ x = v.x;  y = v.y; }
+    constexpr vec4( const vec2& v, const float z, const float w ) :
+	x(v.x), y(v.y), z(z), w(w) {}
 
     //
     //  --- Indexing Operator ---
     //
 
     GLfloat& operator [] ( int i ) { return *(&x + i); }
-    const GLfloat operator [] ( int i ) const { return *(&x + i); }
+    constexpr GLfloat operator [] ( int i ) const
+	{ return i == 0 ? x : i == 1 ? y : i == 2 ? z : w; }
 
     //
     //  --- (non-modifying) Arithematic Operators ---
     //
 
-    vec4 operator - () const  // unary minus operator
+    constexpr vec4 operator - () const  // unary minus operator
 	{ return vec4( -x, -y, -z, -w ); }
 
-    vec4 operator + ( const vec4& v ) const
+    constexpr vec4 operator + ( const vec4& v ) const
 	{ return vec4( x + v.x, y + v.y, z + v.z, w + v.w ); }
 
-    vec4 operator - ( const vec4& v ) const
+    constexpr vec4 operator - ( const vec4& v ) const
 	{ return vec4( x - v.x, y - v.y, z - v.z, w - v.w ); }
 
-    vec4 operator * ( const GLfloat s ) const
+    constexpr vec4 operator * ( const GLfloat s ) const
 	{ return vec4( s*x, s*y, s*z, s*w ); }
 
-    vec4 operator * ( const vec4& v ) const
-	{ return vec4( x*v.x, y*v.y, z*v.z, w*v.z ); }
+    constexpr vec4 operator * ( const vec4& v ) const
+	{ return vec4( x*v.x, y*v.y, z*v.z, w*v.w ); }
 
-    friend vec4 operator * ( const GLfloat s, const vec4& v )
+    friend constexpr vec4 operator * ( const GLfloat s, const vec4& v )
 	{ return v * s; }
 
     vec4 operator / ( const GLfloat s ) const {
@@ -428,9 +425,9 @@ struct vec4 {
 //  Non-class vec4 Methods
 //
 
-inline
+inline constexpr
 GLfloat dot( const vec4& u, const vec4& v ) {
-    return u.x*v.x + u.y*v.y + u.z*v.z + u.w+v.w;
+    return u.x*v.x + u.y*v.y + u.z*v.z + u.w*v.w;
 }
 
 inline
@@ -443,7 +440,7 @@ vec4 normalize( const vec4& v ) {
     return v / length(v);
 }
 
-inline
+inline constexpr
 vec3 cross(const vec4& a, const vec4& b )
 {
     return vec3( a.y * b.z - a.z * b.y,
@@ -451,6 +448,22 @@ vec3 cross(const vec4& a, const vec4& b )
 		 a.x * b.y - a.y * b.x );
 }
 
+//----------------------------------------------------------------------------
+//
+//  Layout checks: the vector types are uploaded to GL as tightly packed
+//    float arrays and copied with memcpy, so their size, alignment and
+//    triviality must not change.
+//
+
+static_assert( sizeof(vec2) == 2*sizeof(GLfloat), "vec2 must be packed" );
+static_assert( sizeof(vec3) == 3*sizeof(GLfloat), "vec3 must be packed" );
+static_assert( sizeof(vec4) == 4*sizeof(GLfloat), "vec4 must be packed" );
+static_assert( alignof(vec4) == 16, "vec4 must be 16-byte aligned" );
+static_assert( std::is_trivially_copyable<vec2>::value &&
+	       std::is_trivially_copyable<vec3>::value &&
+	       std::is_trivially_copyable<vec4>::value,
+	       "vector types must be trivially copyable" );
+
 //----------------------------------------------------------------------------
 
 }  // namespace Angel
@@ -0,0 +1,34 @@
+// vertex layouts bound to shader inputs
+
+#include "vertexformat.h"
+
+//----------------------------------------------------------------------------
+
+void vertexFormat::apply( const Program& program, size_t baseOffset ){
+	locations.resize( attribs.size() );
+	for ( size_t i = 0; i < attribs.size(); i++ ) {
+		const vertexAttrib& a = attribs[i];
+		locations[i] = program.attrib( a.name );
+		if ( locations[i] < 0 ) {
+			continue;
+		}
+		glEnableVertexAttribArray( locations[i] );
+		if ( a.divisor != 0 ) {
+			glVertexAttribDivisor( locations[i], a.divisor );
+		}
+	}
+	rebase( baseOffset );
+}
+
+//----------------------------------------------------------------------------
+
+void vertexFormat::rebase( size_t baseOffset ) const{
+	for ( size_t i = 0; i < locations.size(); i++ ) {
+		const vertexAttrib& a = attribs[i];
+		if ( locations[i] < 0 ) {
+			continue;
+		}
+		glVertexAttribPointer( locations[i], a.size, a.type, a.normalized, a.stride,
+			BUFFER_OFFSET(baseOffset + a.offset) );
+	}
+}
@@ -0,0 +1,148 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  --- vertexformat.h ---
+//
+//   Description of interleaved vertex layouts, and the packed attribute
+//     encodings they use
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef __VERTEXFORMAT_H__
+#define __VERTEXFORMAT_H__
+
+#include "Angel.h"
+#include <vector>
+#include <cstring>
+
+//  One attribute of a vertex layout
+struct vertexAttrib{
+	const char* name;	// shader input it feeds
+	GLint       size;	// components
+	GLenum      type;
+	GLboolean   normalized;
+	size_t      offset;	// bytes from the start of the buffer region
+	GLsizei     stride;	// bytes from one vertex to the next
+	GLuint      divisor;	// instances per element, or 0 for per vertex
+
+	//  Attributes are per vertex unless a divisor is given
+	vertexAttrib( const char* name, GLint size, GLenum type, GLboolean normalized,
+		size_t offset, GLsizei stride, GLuint divisor = 0 )
+		: name(name), size(size), type(type), normalized(normalized),
+		  offset(offset), stride(stride), divisor(divisor) {}
+};
+
+//  Where every attribute of a set of vertices, or instances, lives in a
+//    buffer
+struct vertexFormat{
+	std::vector<vertexAttrib> attribs;
+	size_t bytesPerVertex;
+	std::vector<GLint> locations;	// of each attribute, as of the last apply()
+
+	//  Points the inputs of program at vertices starting baseOffset bytes
+	//    into the bound GL_ARRAY_BUFFER.  Attributes the program doesn't
+	//    use are skipped.
+	void apply( const Program& program, size_t baseOffset );
+
+	//  Points the inputs set up by the last apply() at vertices starting
+	//    baseOffset bytes into the bound GL_ARRAY_BUFFER, without looking
+	//    them up again
+	void rebase( size_t baseOffset ) const;
+};
+
+//  Size in bytes of one component of type
+inline size_t componentSize( GLenum type ){
+	switch ( type ) {
+		case GL_BYTE: case GL_UNSIGNED_BYTE:
+			return 1;
+		case GL_SHORT: case GL_UNSIGNED_SHORT: case GL_HALF_FLOAT:
+			return 2;
+		default:
+			return 4;
+	}
+}
+
+//  Returns a layout where each vertex is a struct whose members are given
+//    in order by attribs; their offsets and the stride are filled in,
+//    aligning every member to 4 bytes as GL recommends
+inline vertexFormat interleaved( std::vector<vertexAttrib> attribs ){
+	vertexFormat format;
+	size_t offset = 0;
+
+	for ( size_t i = 0; i < attribs.size(); i++ ) {
+		attribs[i].offset = offset;
+		offset += (componentSize(attribs[i].type) * attribs[i].size + 3) & ~size_t(3);
+	}
+	for ( size_t i = 0; i < attribs.size(); i++ ) {
+		attribs[i].stride = offset;
+	}
+
+	format.attribs = attribs;
+	format.bytesPerVertex = offset;
+	return format;
+}
+
+//----------------------------------------------------------------------------
+//
+//  --- Attribute encodings ---
+//
+
+//  IEEE half float, for GL_HALF_FLOAT attributes, rounded to nearest even
+inline GLushort toHalf( float f ){
+	GLuint x;
+	memcpy( &x, &f, sizeof(x) );
+
+	GLushort sign = (x >> 16) & 0x8000;
+	int exponent = int((x >> 23) & 0xff) - 127 + 15;
+	GLuint mantissa = x & 0x7fffff;
+
+	if ( (x & 0x7fffffff) > 0x7f800000 ) {
+		return sign | 0x7e00;	// NaN
+	}
+	if ( exponent >= 31 ) {
+		return sign | 0x7c00;	// too large, or infinite
+	}
+
+	int shift = 13;
+	GLuint h = GLuint(exponent) << 10;
+	if ( exponent <= 0 ) {
+		// Subnormal: the implicit leading one becomes explicit
+		if ( exponent < -10 ) {
+			return sign;
+		}
+		mantissa |= 0x800000;
+		shift = 14 - exponent;
+		h = 0;
+	}
+
+	GLuint halfway = 1u << (shift - 1);
+	GLuint rest = mantissa & ((1u << shift) - 1);
+	h |= mantissa >> shift;
+	if ( rest > halfway || (rest == halfway && (h & 1)) ) {
+		h++;	// may carry into the exponent, which is still correct
+	}
+	return sign | GLushort(h);
+}
+
+//  Unit vector folded onto an octahedron and stored as two GL_SHORTs, to be
+//    read back as normalized floats and unfolded by octDecode() in the shader
+inline void octEncode( const vec3& n, GLshort out[2] ){
+	GLfloat l1 = fabs(n.x) + fabs(n.y) + fabs(n.z);
+	GLfloat x = 0.0, y = 0.0;
+	if ( l1 > DivideByZeroTolerance ) {
+		x = n.x / l1;
+		y = n.y / l1;
+	}
+
+	// The lower half folds over the diagonals onto the corners
+	if ( n.z < 0.0 ) {
+		GLfloat fx = (1.0 - fabs(y)) * (x >= 0.0 ? 1.0 : -1.0);
+		GLfloat fy = (1.0 - fabs(x)) * (y >= 0.0 ? 1.0 : -1.0);
+		x = fx;
+		y = fy;
+	}
+
+	out[0] = GLshort( round(x * 32767.0) );
+	out[1] = GLshort( round(y * 32767.0) );
+}
+
+#endif // __VERTEXFORMAT_H__
@@ -1,25 +1,70 @@
 #version 130
+#extension GL_ARB_uniform_buffer_object : require
+#ifdef HAS_DRAW_PARAMETERS
+#extension GL_ARB_shader_draw_parameters : require
+#endif
 
-uniform mat4 modelMatrix;
-uniform mat4 viewMatrix;
-uniform mat4 projectionMatrix;
-uniform vec4 LightPosition;
+// The ball mesh.  Built with INSTANCED, each instance brings its own
+//   transform and color, and otherwise the draw's data does.
+//   NORMAL_ENCODING says where the normal comes from, matching
+//   sphereNormals in sphere.h: 0 in_normals, 1 octahedral in_normals.xy,
+//   2 the position itself.
+
+#include "camera.glsl"
 
 in vec4 in_position;
 in vec3 in_normals;
 
+#ifdef INSTANCED
+// Per instance: the rows of its Transform, and the ball's color
+in vec4 in_model0;
+in vec4 in_model1;
+in vec4 in_model2;
+in vec4 in_tint;
+#else
+#include "draws.glsl"
+#endif
+
 out vec3 fN;
 out vec3 fE;
-out vec3 fL;
+out vec4 fTint;
+
+// Unfolds a normal packed by octEncode() in vertexformat.h
+vec3 octDecode( vec2 e ){
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	if( n.z < 0.0 ) {
+		n.xy = (1.0 - abs(n.yx)) * mix(vec2(-1.0), vec2(1.0), step(0.0, n.xy));
+	}
+	return normalize(n);
+}
 
 void main(){
-	fN = in_normals;
-	fE = ((viewMatrix*modelMatrix)*in_position).xyz;
-	fL = LightPosition.xyz;
+#ifdef INSTANCED
+	mat4 model = transpose(mat4(in_model0, in_model1, in_model2, vec4(0.0, 0.0, 0.0, 1.0)));
+	mat4 modelView = viewMatrix*model;
+	vec4 position = modelView*in_position;
+#else
+	vec4 position = DRAW.modelView*in_position;
+#endif
 
-	if( LightPosition.w != 0.0 ) {
-		fL = LightPosition.xyz - in_position.xyz;
-	}
+#if NORMAL_ENCODING == 1
+	vec3 normal = octDecode(in_normals.xy);
+#elif NORMAL_ENCODING == 2
+	vec3 normal = in_position.xyz;
+#else
+	vec3 normal = in_normals;
+#endif
+
+#ifdef INSTANCED
+	// Balls are only moved and uniformly scaled, so the model-view matrix
+	//   turns normals the right way; fshader_lights.glsl renormalizes them
+	fN = mat3(modelView)*normal;
+	fTint = in_tint;
+#else
+	fN = drawNormal(normal);
+	fTint = DRAW.tint;
+#endif
+	fE = position.xyz;
 
-	gl_Position=projectionMatrix*viewMatrix*modelMatrix*in_position; 
+	gl_Position=projectionMatrix*position; 
 }
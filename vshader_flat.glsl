@@ -0,0 +1,28 @@
+#version 130
+#extension GL_ARB_uniform_buffer_object : require
+#ifdef HAS_DRAW_PARAMETERS
+#extension GL_ARB_shader_draw_parameters : require
+#endif
+
+// The paddle and wall: unlit, colored per vertex or by the texture as
+//   each draw's data says
+
+#include "camera.glsl"
+#include "draws.glsl"
+
+in vec3 in_position;
+in vec4 in_color;
+in vec2 texcoord;
+
+out vec4 pass_color;
+out vec2 f_texcoord;
+flat out vec4 f_tint;
+flat out float f_textured;
+
+void main(){
+  gl_Position=projectionMatrix*DRAW.modelView*vec4(in_position,1.0); 
+  pass_color=in_color;
+  f_texcoord = texcoord;
+  f_tint = DRAW.tint;
+  f_textured = DRAW.textured;
+}
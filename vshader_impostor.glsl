@@ -0,0 +1,40 @@
+#version 130
+#extension GL_ARB_uniform_buffer_object : require
+#ifdef HAS_DRAW_PARAMETERS
+#extension GL_ARB_shader_draw_parameters : require
+#endif
+
+#include "camera.glsl"
+#include "draws.glsl"
+
+// Camera-facing quad just big enough to cover a sphere of radius Radius
+//   around the model's origin, which fshader_impostor.glsl ray-casts in
+//   the draw's tint
+
+uniform float Radius;
+
+in vec2 in_corner;
+
+out vec3 fRay;
+out vec3 fCenter;
+flat out vec4 fTint;
+
+void main(){
+	vec3 center = (DRAW.modelView*vec4(0.0, 0.0, 0.0, 1.0)).xyz;
+	float d = length(center);
+
+	// The quad faces the eye, at right angles to the line to the centre
+	vec3 axis = center / d;
+	vec3 side = normalize(cross(abs(axis.y) < 0.99 ? vec3(0.0, 1.0, 0.0) : vec3(1.0, 0.0, 0.0), axis));
+	vec3 up = cross(axis, side);
+
+	// Radius of the cone of rays from the eye that graze the sphere, where
+	//   it crosses the quad
+	float extent = Radius * d / sqrt(max(d*d - Radius*Radius, 1e-6));
+
+	fRay = center + extent*(in_corner.x*side + in_corner.y*up);
+	fCenter = center;
+	fTint = DRAW.tint;
+
+	gl_Position = projectionMatrix*vec4(fRay, 1.0);
+}